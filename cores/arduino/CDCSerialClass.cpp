@@ -30,7 +30,13 @@
 #include "wiring_digital.h"
 #include "variant.h"
 
-#define CDCACM_FIXED_DELAY     120
+/* Give up on a write if the LMT frees no space in the Tx ring for this long */
+#define CDCACM_WRITE_TIMEOUT_MS    100
+
+/* The ring indices are updated by the other core behind our back */
+#define CDC_RING_HEAD(rb)    (*(volatile int *)&(rb)->head)
+#define CDC_RING_TAIL(rb)    (*(volatile int *)&(rb)->tail)
+#define CDC_RING_BARRIER()   __asm__ __volatile__("" ::: "memory")
 
 extern void CDCSerial_Handler(void);
 extern void serialEventRun1(void) __attribute__((weak));
@@ -65,10 +71,6 @@ void CDCSerialClass::begin(const uint32_t dwBaudRate, const uint8_t config)
 
 void CDCSerialClass::init(const uint32_t dwBaudRate, const uint8_t modeReg)
 {
-    /* Set a per-byte write delay approximately equal to the time it would
-     * take to clock out a byte on a standard UART at this baud rate */
-    _writeDelayUsec = 8000000 / dwBaudRate;
-
     /* Make sure both ring buffers are initialized back to empty.
      * Empty the Rx buffer but don't touch Tx buffer: it is drained by the
      * LMT one way or another */
@@ -92,13 +94,41 @@ int CDCSerialClass::available( void )
     return (int)(SBS + _rx_buffer->head - _rx_buffer->tail) % SBS;
 }
 
+size_t CDCSerialClass::peekSpan(const uint8_t **data)
+{
+    if (!_shared_data->device_open)
+        return 0;
+
+    int head = CDC_RING_HEAD(_rx_buffer);
+    int tail = _rx_buffer->tail;
+
+    CDC_RING_BARRIER();
+    *data = &_rx_buffer->data[tail];
+    /* Only the part up to the end of the ring is contiguous */
+    return (head >= tail) ? head - tail : CDCACM_BUFFER_SIZE - tail;
+}
+
+void CDCSerialClass::consume(size_t len)
+{
+    if (!_shared_data->device_open)
+        return;
+
+    /* Never move the tail past the head, the other core owns the rest */
+    size_t avail = (size_t)available();
+    if (len > avail)
+        len = avail;
+
+    CDC_RING_BARRIER();
+    _rx_buffer->tail = (_rx_buffer->tail + len) % CDCACM_BUFFER_SIZE;
+}
+
 int CDCSerialClass::availableForWrite(void)
 {
     if (!_shared_data->device_open || !_shared_data->host_open)
         return(0);
 
     int head = _tx_buffer->head;
-    int tail = _tx_buffer->tail;
+    int tail = CDC_RING_TAIL(_tx_buffer);
 
     if (head >= tail)
         return CDCACM_BUFFER_SIZE - head + tail - 1;
@@ -123,9 +153,49 @@ int CDCSerialClass::read( void )
   return uc;
 }
 
+/* Copy what the Rx ring holds, at most its two contiguous spans */
+size_t CDCSerialClass::popBytes(uint8_t *buffer, size_t length)
+{
+  const uint8_t *data;
+  size_t count = 0;
+  size_t n;
+
+  while (count < length && (n = peekSpan(&data)) > 0) {
+    if (n > length - count)
+      n = length - count;
+    memcpy(buffer + count, data, n);
+    consume(n);
+    count += n;
+  }
+  return count;
+}
+
+size_t CDCSerialClass::readBytes( char *buffer, size_t length )
+{
+  // Drain whatever is already buffered in one go, then wait for the rest
+  // with the same per-character timeout as Stream::readBytes()
+  size_t count = popBytes((uint8_t *)buffer, length);
+
+  _startMillis = millis();
+  while (count < length)
+  {
+    size_t n = popBytes((uint8_t *)buffer + count, length - count);
+    if (n)
+    {
+      count += n;
+      _startMillis = millis();
+    }
+    else if (millis() - _startMillis >= _timeout)
+    {
+      break;
+    }
+  }
+  return count;
+}
+
 void CDCSerialClass::flush( void )
 {
-    while (_tx_buffer->tail != _tx_buffer->head) { /* This infinite loop is intentional
+    while (CDC_RING_TAIL(_tx_buffer) != _tx_buffer->head) { /* This infinite loop is intentional
 						      and requested by design */
 	    delayMicroseconds(1);
     }
@@ -133,26 +203,44 @@ void CDCSerialClass::flush( void )
 
 size_t CDCSerialClass::write( const uint8_t uc_data )
 {
-    uint32_t retries = 2;
+    return write(&uc_data, 1);
+}
+
+size_t CDCSerialClass::write( const uint8_t *buffer, size_t size )
+{
+    size_t sent = 0;
+    uint32_t start = millis();
 
     if (!_shared_data->device_open || !_shared_data->host_open)
         return(0);
 
-    do {
-        int i = (uint32_t)(_tx_buffer->head + 1) % CDCACM_BUFFER_SIZE;
-        // if we should be storing the received character into the location
-        // just before the tail (meaning that the head would advance to the
-        // current location of the tail), we're about to overflow the buffer
-        // and so we don't write the character or advance the head.
-        if (i != _tx_buffer->tail) {
-            _tx_buffer->data[_tx_buffer->head] = uc_data;
-            _tx_buffer->head = i;
-
-	    // Just use a fixed delay to make it compatible with the CODK-M based firmware
-	    delayMicroseconds(CDCACM_FIXED_DELAY);
-            break;
+    while (sent < size) {
+        int head = _tx_buffer->head;
+        int tail = CDC_RING_TAIL(_tx_buffer);
+        /* One slot is always left empty so that head == tail means empty */
+        int space = (head >= tail) ? CDCACM_BUFFER_SIZE - head + tail - 1 : tail - head - 1;
+
+        if (space == 0) {
+            /* Ring is full: wait for the LMT to drain it, but don't hang
+             * forever if the host stops reading */
+            if (!_shared_data->host_open ||
+                (millis() - start) >= CDCACM_WRITE_TIMEOUT_MS)
+                break;
+            continue;
         }
-    } while (retries--);
 
-    return 1;
+        /* Copy as much as fits in at most two contiguous segments and
+         * publish the new head once */
+        size_t len = min(size - sent, (size_t)space);
+        size_t first = min(len, (size_t)(CDCACM_BUFFER_SIZE - head));
+        memcpy(&_tx_buffer->data[head], buffer + sent, first);
+        memcpy(&_tx_buffer->data[0], buffer + sent + first, len - first);
+        CDC_RING_BARRIER();
+        CDC_RING_HEAD(_tx_buffer) = (head + len) % CDCACM_BUFFER_SIZE;
+
+        sent += len;
+        start = millis();
+    }
+
+    return sent;
 }
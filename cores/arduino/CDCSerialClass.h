@@ -43,10 +43,19 @@ class CDCSerialClass : public HardwareSerial
     int available(void);
     int availableForWrite(void);
     int peek(void);
+    /* Zero-copy access to the shared Rx ring: returns the number of bytes
+     * readable in place at *data (up to the end of the ring, so call again
+     * after consume() to get any wrapped remainder). consume() drops at
+     * most what available() reports */
+    size_t peekSpan(const uint8_t **data);
+    void consume(size_t len);
     int read(void);
+    size_t readBytes(char *buffer, size_t length);
+    using Stream::readBytes; // pull in readBytes(uint8_t *, size) from Stream
     void flush(void);
     size_t write(const uint8_t c);
-    using Print::write; // pull in write(str) and write(buf, size) from Print
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write; // pull in write(str) from Print
 
     operator bool() {
 	/* In case bool() is called in a very tight while loop, give LMT space
@@ -57,13 +66,13 @@ class CDCSerialClass : public HardwareSerial
 
   protected:
     void init(const uint32_t dwBaudRate, const uint8_t config);
+    size_t popBytes(uint8_t *buffer, size_t length);
 
     struct cdc_acm_shared_data *_shared_data;
     struct cdc_ring_buffer *_rx_buffer;
     struct cdc_ring_buffer *_tx_buffer;
 
     uart_init_info *info;
-    uint32_t _writeDelayUsec;
     uint32_t _dwId;
 };
 
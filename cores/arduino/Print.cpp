@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <stdarg.h>
 #include "Arduino.h"
 
 #include "Print.h"
@@ -46,11 +47,7 @@ size_t Print::print(const __FlashStringHelper *ifsh)
 
 size_t Print::print(const String &s)
 {
-  size_t n = 0;
-  for (uint16_t i = 0; i < s.length(); i++) {
-    n += write(s[i]);
-  }
-  return n;
+  return write(s.c_str(), s.length());
 }
 
 size_t Print::print(const char str[])
@@ -65,61 +62,37 @@ size_t Print::print(char c)
 
 size_t Print::print(unsigned char b, int base)
 {
-  return print((unsigned long) b, base);
+  return printUnsigned((unsigned long) b, base, false);
 }
 
 size_t Print::print(int n, int base)
 {
-  return print((long) n, base);
+  return printSigned((long) n, base, false);
 }
 
 size_t Print::print(unsigned int n, int base)
 {
-  return print((unsigned long) n, base);
+  return printUnsigned((unsigned long) n, base, false);
 }
 
 size_t Print::print(long n, int base)
 {
-  if (base == 0) {
-    return write(n);
-  } else if (base == DEC) {
-    if (n < 0) {
-      int t = print('-');
-      n = -n;
-      return printNumber(n, DEC) + t;
-    }
-    return printNumber(n, DEC);
-  } else {
-    return printNumber(n, base);
-  }
+  return printSigned(n, base, false);
 }
 
 size_t Print::print(long long n, int base)
 {
-  if (base == 0) {
-    return write(n);
-  } else if (base == DEC) {
-    if (n < 0) {
-      int t = print('-');
-      n = -n;
-      return printLongLong(n, DEC) + t;
-    }
-    return printLongLong(n, DEC);
-  } else {
-    return printLongLong(n, base);
-  }
+  return printSigned(n, base, false);
 }
 
 size_t Print::print(unsigned long n, int base)
 {
-  if (base == 0) return write(n);
-  else return printNumber(n, base);
+  return printUnsigned(n, base, false);
 }
 
 size_t Print::print(unsigned long long n, int base)
 {
-  if (base == 0) return write(n);
-  else return printLongLong(n, base);
+  return printUnsigned(n, base, false);
 }
 
 size_t Print::print(double n, int digits)
@@ -141,9 +114,7 @@ size_t Print::print(const Printable& x)
 
 size_t Print::println(void)
 {
-  size_t n = print('\r');
-  n += print('\n');
-  return n;
+  return write("\r\n", 2);
 }
 
 size_t Print::println(const String &s)
@@ -162,65 +133,48 @@ size_t Print::println(const char c[])
 
 size_t Print::println(char c)
 {
-  size_t n = print(c);
-  n += println();
-  return n;
+  char buf[3] = { c, '\r', '\n' };
+  return write(buf, sizeof(buf));
 }
 
 size_t Print::println(unsigned char b, int base)
 {
-  size_t n = print(b, base);
-  n += println();
-  return n;
+  return printUnsigned((unsigned long) b, base, true);
 }
 
 size_t Print::println(int num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return printSigned((long) num, base, true);
 }
 
 size_t Print::println(unsigned int num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return printUnsigned((unsigned long) num, base, true);
 }
 
 size_t Print::println(long num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return printSigned(num, base, true);
 }
 
 size_t Print::println(long long num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return printSigned(num, base, true);
 }
 
 size_t Print::println(unsigned long num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return printUnsigned(num, base, true);
 }
 
 size_t Print::println(unsigned long long num, int base)
 {
-  size_t n = print(num, base);
-  n += println();
-  return n;
+  return printUnsigned(num, base, true);
 }
 
 size_t Print::println(double num, int digits)
 {
-  size_t n = print(num, digits);
-  n += println();
-  return n;
+  return printFloat(num, digits, true);
 }
 
 size_t Print::println(const Printable& x)
@@ -230,18 +184,91 @@ size_t Print::println(const Printable& x)
   return n;
 }
 
+size_t Print::printf(const char *format, ...)
+{
+  char buf[PRINTF_BUFFER_SIZE];
+  va_list args;
+
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (len < 0)
+    return 0;
+  if ((size_t)len < sizeof(buf))
+    return write(buf, len);
+
+  char *big = (char *)malloc(len + 1);
+  if (big == NULL)
+    return write(buf, sizeof(buf) - 1);
+  va_start(args, format);
+  vsnprintf(big, len + 1, format, args);
+  va_end(args);
+  size_t n = write(big, len);
+  free(big);
+  return n;
+}
+
 // Private Methods /////////////////////////////////////////////////////////////
 
-size_t Print::printNumber(unsigned long n, uint8_t base) {
-  char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
-  char *str = &buf[sizeof(buf) - 1];
+size_t Print::printSigned(long n, int base, bool newline)
+{
+  if (base == 0) {
+    size_t t = write(n);
+    return newline ? t + println() : t;
+  }
+  if (base == DEC && n < 0)
+    return printNumber(0UL - (unsigned long)n, DEC, true, newline);
+  return printNumber(n, base, false, newline);
+}
 
-  *str = '\0';
+size_t Print::printSigned(long long n, int base, bool newline)
+{
+  if (base == 0) {
+    size_t t = write(n);
+    return newline ? t + println() : t;
+  }
+  if (base == DEC && n < 0)
+    return printLongLong(0ULL - (unsigned long long)n, DEC, true, newline);
+  return printLongLong(n, base, false, newline);
+}
+
+size_t Print::printUnsigned(unsigned long n, int base, bool newline)
+{
+  if (base == 0) {
+    size_t t = write(n);
+    return newline ? t + println() : t;
+  }
+  return printNumber(n, base, false, newline);
+}
+
+size_t Print::printUnsigned(unsigned long long n, int base, bool newline)
+{
+  if (base == 0) {
+    size_t t = write(n);
+    return newline ? t + println() : t;
+  }
+  return printLongLong(n, base, false, newline);
+}
+
+// Fill 'end' backwards with the digits of 'n', returning the first one.
+// Decimal gets its own loop so the division is by a constant.
+template <typename T>
+static char *formatDigits(char *end, T n, uint8_t base)
+{
+  char *str = end;
+
+  if (base == DEC) {
+    do {
+      T m = n;
+      n /= 10;
+      *--str = '0' + (char)(m - 10 * n);
+    } while (n);
+    return str;
+  }
 
   switch(base) {
     case BIN:
     case OCT:
-    case DEC:
     case HEX:
 	  break;
     default:
@@ -249,47 +276,61 @@ size_t Print::printNumber(unsigned long n, uint8_t base) {
   }
 
   do {
-    unsigned long m = n;
+    T m = n;
     n /= base;
     char c = m - base * n;
     *--str = c < 10 ? c + '0' : c + 'A' - 10;
   } while(n);
-
-  return write(str);
+  return str;
 }
 
+size_t Print::printNumber(unsigned long n, uint8_t base, bool negative, bool newline) {
+  // Assumes 8-bit chars, plus sign, line ending and zero byte.
+  char buf[8 * sizeof(long) + 4];
+  char *end = &buf[sizeof(buf) - 3];
+
+  if (newline) {
+    end[0] = '\r';
+    end[1] = '\n';
+  }
 
-size_t Print::printLongLong(unsigned long long n, uint8_t base) {
-  char buf[8 * sizeof(long long) + 1]; // Assumes 8-bit chars plus zero byte.
-  char *str = &buf[sizeof(buf) - 1];
+  char *str = formatDigits(end, n, base);
+  if (negative)
+    *--str = '-';
 
-  *str = '\0';
+  return write(str, end - str + (newline ? 2 : 0));
+}
 
-  switch(base) {
-    case BIN:
-    case OCT:
-    case DEC:
-    case HEX:
-	  break;
-    default:
-	  base = DEC;
+
+size_t Print::printLongLong(unsigned long long n, uint8_t base, bool negative, bool newline) {
+  // Assumes 8-bit chars, plus sign, line ending and zero byte.
+  char buf[8 * sizeof(long long) + 4];
+  char *end = &buf[sizeof(buf) - 3];
+
+  if (newline) {
+    end[0] = '\r';
+    end[1] = '\n';
   }
 
-  do {
-    unsigned long long m = n;
-    n /= base;
-    char c = m - base * n;
-    *--str = c < 10 ? c + '0' : c + 'A' - 10;
-  } while(n);
+  char *str = formatDigits(end, n, base);
+  if (negative)
+    *--str = '-';
 
-  return write(str);
+  return write(str, end - str + (newline ? 2 : 0));
 }
 
 
-size_t Print::printFloat(double number, uint8_t digits)
+size_t Print::printFloat(double number, uint8_t digits, bool newline)
 {
-  char str[50];
+  char str[52];
 
   dtostrf(number, 0, digits, str);
-  return(print(str));
+  size_t len = strlen(str);
+  if (newline && len + 2 > sizeof(str))
+    return write(str, len) + println();
+  if (newline) {
+    str[len++] = '\r';
+    str[len++] = '\n';
+  }
+  return write(str, len);
 }
@@ -31,13 +31,21 @@
 #define OCT 8
 #define BIN 2
 
+#define PRINTF_BUFFER_SIZE 64
+
 class Print
 {
   private:
     int write_error;
-    size_t printNumber(unsigned long, uint8_t);
-    size_t printLongLong(unsigned long long, uint8_t);
-    size_t printFloat(double, uint8_t);
+    // Each formats the whole field, sign and optional line ending included,
+    // into a stack buffer and hands it to the sink with a single write()
+    size_t printNumber(unsigned long, uint8_t, bool negative = false, bool newline = false);
+    size_t printLongLong(unsigned long long, uint8_t, bool negative = false, bool newline = false);
+    size_t printFloat(double, uint8_t, bool newline = false);
+    size_t printSigned(long, int, bool);
+    size_t printSigned(long long, int, bool);
+    size_t printUnsigned(unsigned long, int, bool);
+    size_t printUnsigned(unsigned long long, int, bool);
   protected:
     void setWriteError(int err = 1) { write_error = err; }
   public:
@@ -84,6 +92,10 @@ class Print
     size_t println(double, int = BIN);
     size_t println(const Printable&);
     size_t println(void);
+
+    // Formatted output: fields up to PRINTF_BUFFER_SIZE - 1 characters go
+    // out in one write() from the stack, longer ones through a heap copy
+    size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
 };
 
 #endif
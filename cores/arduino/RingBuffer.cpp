@@ -19,28 +19,66 @@
 */
 
 #include "RingBuffer.h"
+#include <stdlib.h>
 #include <string.h>
 
-RingBuffer::RingBuffer( void )
+RingBuffer::RingBuffer( uint16_t size )
 {
-    _aucBuffer = (uint8_t*)dccm_malloc(UART_BUFFER_SIZE);
-    memset( _aucBuffer, 0, UART_BUFFER_SIZE ) ;
-    _iHead=0 ;
-    _iTail=0 ;
+    _aucBuffer = NULL;
+    _size = 0;
+    _mask = 0;
+    clear();
+    allocate(size);
+}
+
+bool RingBuffer::allocate( uint16_t size, bool dmaCapable )
+{
+    uint32_t newSize = 1;
+    while (newSize < size)
+        newSize <<= 1;
+
+    // Prefer DCCM, falling back to SRAM once it is exhausted
+    uint8_t *buf = NULL;
+    if (!dmaCapable && newSize <= DCCM_SIZE)
+        buf = (uint8_t*)dccm_malloc(newSize);
+    if (buf == NULL)
+        buf = (uint8_t*)malloc(newSize);
+    if (buf == NULL)
+        return false;
+
+    release();
+    _aucBuffer = buf;
+    _size = newSize;
+    _mask = _size - 1;
+
+    memset( _aucBuffer, 0, _size ) ;
+    clear();
+    return true;
+}
+
+void RingBuffer::release( void )
+{
+    if (dccm_owns(_aucBuffer))
+        dccm_free(_aucBuffer);
+    else
+        free(_aucBuffer);
+    _aucBuffer = NULL;
+    _size = 0;
+    _mask = 0;
+    clear();
 }
 
 void RingBuffer::store_char( uint8_t c )
 {
-  int i = (uint32_t)(_iHead + 1) % UART_BUFFER_SIZE ;
+  uint32_t head = _iHead;
 
-  // if we should be storing the received character into the location
-  // just before the tail (meaning that the head would advance to the
-  // current location of the tail), we're about to overflow the buffer
-  // and so we don't write the character or advance the head.
-  if ( i != _iTail )
+  // if the buffer is full we're about to overwrite the oldest character,
+  // so we don't write the character or advance the head.
+  if ( (uint32_t)(head - _iTail) != _size )
   {
-    _aucBuffer[_iHead] = c ;
-    _iHead = i ;
+    _aucBuffer[head & _mask] = c ;
+    RING_BUFFER_BARRIER();
+    _iHead = head + 1 ;
     _buffer_overflow = false;
   }
   else
@@ -49,3 +87,104 @@ void RingBuffer::store_char( uint8_t c )
   }
 }
 
+size_t RingBuffer::push( const uint8_t *data, size_t len )
+{
+  uint32_t head = _iHead;
+  size_t space = _size - (uint32_t)(head - _iTail);
+
+  if (len > space)
+    len = space;
+
+  // At most two segments: up to the end of the storage, then from the start
+  uint32_t idx = head & _mask;
+  size_t first = _size - idx;
+  if (first > len)
+    first = len;
+  memcpy(_aucBuffer + idx, data, first);
+  memcpy(_aucBuffer, data + first, len - first);
+
+  RING_BUFFER_BARRIER();
+  _iHead = head + len;
+  return len;
+}
+
+size_t RingBuffer::writeSpan( uint8_t **data )
+{
+  uint32_t head = _iHead;
+  uint32_t idx = head & _mask;
+  size_t space = _size - (uint32_t)(head - _iTail);
+  size_t contig = _size - idx;
+
+  *data = _aucBuffer + idx;
+  return (space < contig) ? space : contig;
+}
+
+void RingBuffer::commit( size_t len )
+{
+  RING_BUFFER_BARRIER();
+  _iHead = _iHead + len;
+}
+
+int RingBuffer::read_char( void )
+{
+  uint32_t tail = _iTail;
+
+  if ( _iHead == tail )
+    return -1;
+
+  RING_BUFFER_BARRIER();
+  uint8_t uc = _aucBuffer[tail & _mask];
+  RING_BUFFER_BARRIER();
+  _iTail = tail + 1;
+  return uc;
+}
+
+int RingBuffer::peek( void ) const
+{
+  uint32_t tail = _iTail;
+
+  if ( _iHead == tail )
+    return -1;
+
+  RING_BUFFER_BARRIER();
+  return _aucBuffer[tail & _mask];
+}
+
+size_t RingBuffer::pop( uint8_t *data, size_t len )
+{
+  uint32_t tail = _iTail;
+  size_t count = (uint32_t)(_iHead - tail);
+
+  if (len > count)
+    len = count;
+
+  RING_BUFFER_BARRIER();
+  uint32_t idx = tail & _mask;
+  size_t first = _size - idx;
+  if (first > len)
+    first = len;
+  memcpy(data, _aucBuffer + idx, first);
+  memcpy(data + first, _aucBuffer, len - first);
+
+  RING_BUFFER_BARRIER();
+  _iTail = tail + len;
+  return len;
+}
+
+size_t RingBuffer::readSpan( const uint8_t **data ) const
+{
+  uint32_t tail = _iTail;
+  uint32_t idx = tail & _mask;
+  size_t count = (uint32_t)(_iHead - tail);
+  size_t contig = _size - idx;
+
+  RING_BUFFER_BARRIER();
+  *data = _aucBuffer + idx;
+  return (count < contig) ? count : contig;
+}
+
+void RingBuffer::consume( size_t len )
+{
+  RING_BUFFER_BARRIER();
+  _iTail = _iTail + len;
+}
@@ -18,25 +18,79 @@
 #define _RING_BUFFER_
 
 #include <stdint.h>
+#include <stddef.h>
 #include "dccm/dccm_alloc.h"
 
-// Define constants and variables for buffering incoming serial data.  We're
-// using a ring buffer (I think), in which head is the index of the location
-// to which to write the next incoming character and tail is the index of the
-// location from which to read.
+// Single-producer/single-consumer ring buffer for serial data.  The producer
+// (typically an ISR) only ever moves the head, the consumer only ever moves
+// the tail, so no locking is needed as long as there is exactly one of each.
+// Head and tail are free-running counters: the number of stored bytes is
+// always (head - tail) and the capacity is a power of two so that indexing
+// is a mask rather than a modulo.
 #define UART_BUFFER_SIZE 64
 
+// Keep the compiler from moving buffer accesses across index updates
+#define RING_BUFFER_BARRIER()	__asm__ __volatile__("" ::: "memory")
+
 class RingBuffer
 {
 public:
-	uint8_t *_aucBuffer;
-	volatile int _iHead ;
-	volatile int _iTail ;
-	volatile bool _buffer_overflow ;
+	// size is rounded up to the next power of two
+	RingBuffer( uint16_t size = UART_BUFFER_SIZE ) ;
+	~RingBuffer( void ) { release(); }
+
+	// Replace the storage, discarding any content; only safe while neither
+	// side is running.  Storage comes from DCCM when there is room left and
+	// from SRAM otherwise.  The SoC DMA controller cannot reach DCCM, so
+	// storage used as a DMA source or destination is always taken from SRAM.
+	bool allocate( uint16_t size, bool dmaCapable = false ) ;
+	// Give the storage back to DCCM or the heap; allocate() before reuse
+	void release( void ) ;
+	const uint8_t *buffer( void ) const { return _aucBuffer; }
 
-	RingBuffer( void ) ;
+	// Producer side
 	void store_char( uint8_t c ) ;
+	size_t push( const uint8_t *data, size_t len ) ;
+	size_t availableForStore( void ) const { return _size - (uint32_t)(_iHead - _iTail); }
+	// Contiguous free region starting at the head; publish with commit()
+	size_t writeSpan( uint8_t **data ) ;
+	void commit( size_t len ) ;
+
+	// Consumer side
+	int read_char( void ) ;
+	int peek( void ) const ;
+	size_t pop( uint8_t *data, size_t len ) ;
+	size_t available( void ) const { return (uint32_t)(_iHead - _iTail); }
+	// Contiguous readable region starting at the tail; release with consume()
+	size_t readSpan( const uint8_t **data ) const ;
+	void consume( size_t len ) ;
+	// Drop everything currently stored
+	void flush( void ) { _iTail = _iHead; }
+
+	// Only safe while neither side is running
+	void clear( void ) { _iHead = _iTail = 0; _buffer_overflow = false; }
+
+	bool isEmpty( void ) const { return _iHead == _iTail; }
+	bool isFull( void ) const { return (uint32_t)(_iHead - _iTail) == _size; }
+	size_t capacity( void ) const { return _size; }
 	bool overflow() { bool ret = _buffer_overflow; _buffer_overflow = false; return ret; }
+
+protected:
+	uint8_t *_aucBuffer;
+	uint32_t _size;
+	uint32_t _mask;
+	volatile uint32_t _iHead ;
+	volatile uint32_t _iTail ;
+	volatile bool _buffer_overflow ;
+} ;
+
+// Compile-time sized ring buffer, for declaring per-port buffers
+template <uint16_t N>
+class RingBufferN : public RingBuffer
+{
+	static_assert(N != 0 && (N & (N - 1)) == 0, "RingBufferN size must be a power of two");
+public:
+	RingBufferN( void ) : RingBuffer( N ) {}
 } ;
 
 #endif
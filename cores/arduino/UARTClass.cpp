@@ -22,9 +22,18 @@
 #include "Arduino.h"
 #include "portable.h"
 #include "UARTClass.h"
+#include "dma_shared.h"
 #include "wiring_constants.h"
 #include "wiring_digital.h"
 
+#if CONFIG_UART_CONSOLE_INDEX == 0
+#define UART_DMA_TX_INTERFACE   SOC_DMA_INTERFACE_UART0_TX
+#define UART_DMA_RX_INTERFACE   SOC_DMA_INTERFACE_UART0_RX
+#else
+#define UART_DMA_TX_INTERFACE   SOC_DMA_INTERFACE_UART1_TX
+#define UART_DMA_RX_INTERFACE   SOC_DMA_INTERFACE_UART1_RX
+#endif
+
 extern void UART_Handler(void);
 extern void serialEventRun(void) __attribute__((weak));
 extern void serialEvent(void) __attribute__((weak));
@@ -45,10 +54,30 @@ UARTClass::UARTClass( uart_init_info *info, RingBuffer *pRx_buffer, RingBuffer *
    this->info = info;
    this->_rx_buffer = pRx_buffer;
    this->_tx_buffer = pTx_buffer;
+   this->_txNonBlocking = false;
+   this->_txDrainedCallback = NULL;
+   this->_dmaEnabled = false;
+   this->_dmaRxBuffer = NULL;
+   this->opened = false;
+   resetTxStats();
 }
 
 // Public Methods //////////////////////////////////////////////////////////////
 
+bool UARTClass::setRxBufferSize(uint16_t size)
+{
+  if (opened)
+    return false;
+  return _rx_buffer->allocate(size);
+}
+
+bool UARTClass::setTxBufferSize(uint16_t size)
+{
+  if (opened)
+    return false;
+  return _tx_buffer->allocate(size);
+}
+
 void UARTClass::begin(const uint32_t dwBaudRate)
 {
   begin(dwBaudRate, SERIAL_8N1);
@@ -65,8 +94,8 @@ void UARTClass::init(const uint32_t dwBaudRate, const uint8_t modeReg)
 {
   uint8_t c;
   // Make sure both ring buffers are initialized back to empty.
-  _rx_buffer->_iHead = _rx_buffer->_iTail = 0;
-  _tx_buffer->_iHead = _tx_buffer->_iTail = 0;
+  _rx_buffer->clear();
+  _tx_buffer->clear();
 
   SET_PIN_MODE(17, UART_MUX_MODE); // Rdx SOC PIN (Arduino header pin 0)
   SET_PIN_MODE(16, UART_MUX_MODE); // Txd SOC PIN (Arduino header pin 1)
@@ -104,6 +133,8 @@ void UARTClass::end( void )
   uint8_t uc_data;
   // Wait for any outstanding data to be sent
   flush();
+  if (_dmaEnabled)
+    disableDMA();
   uart_irq_rx_disable(CONFIG_UART_CONSOLE_INDEX);
   uart_irq_tx_disable(CONFIG_UART_CONSOLE_INDEX);
   while ( ret != -1 ) {
@@ -111,7 +142,7 @@ void UARTClass::end( void )
   }
   opened = false;
   // Clear any received data
-  _rx_buffer->_iHead = _rx_buffer->_iTail;
+  _rx_buffer->flush();
   
   //enable loopback, needed to prevent a short disconnection to be 
   //interpreted as a packet and corrupt receiver state
@@ -134,61 +165,102 @@ uint32_t UARTClass::getInterruptPriority()
 
 int UARTClass::available( void )
 {
-  return (uint32_t)(UART_BUFFER_SIZE + _rx_buffer->_iHead - _rx_buffer->_iTail) % UART_BUFFER_SIZE;
+  if (_dmaEnabled)
+    dmaRxPoll();
+  return _rx_buffer->available();
 }
 
 int UARTClass::availableForWrite(void)
 {
   if (!opened)
     return(0);
-  int head = _tx_buffer->_iHead;
-  int tail = _tx_buffer->_iTail;
-  if (head >= tail) return UART_BUFFER_SIZE - 1 - head + tail;
-  return tail - head - 1;
+  return _tx_buffer->availableForStore();
 }
 
 int UARTClass::peek( void )
 {
-  if ( _rx_buffer->_iHead == _rx_buffer->_iTail )
-    return -1;
-
-  return _rx_buffer->_aucBuffer[_rx_buffer->_iTail];
+  if (_dmaEnabled)
+    dmaRxPoll();
+  return _rx_buffer->peek();
 }
 
 int UARTClass::read( void )
 {
-  // if the head isn't ahead of the tail, we don't have any characters
-  if ( _rx_buffer->_iHead == _rx_buffer->_iTail )
-    return -1;
-
-  uint8_t uc = _rx_buffer->_aucBuffer[_rx_buffer->_iTail];
-  _rx_buffer->_iTail = (unsigned int)(_rx_buffer->_iTail + 1) % UART_BUFFER_SIZE;
-  return uc;
+  if (_dmaEnabled)
+    dmaRxPoll();
+  return _rx_buffer->read_char();
 }
 
 void UARTClass::flush( void )
 {
-  while (_tx_buffer->_iHead != (_tx_buffer->_iTail)); //wait for transmit data to be sent
+  while (!_tx_buffer->isEmpty()); //wait for transmit data to be sent
   // Wait for transmission to complete
   while(!uart_tx_complete(CONFIG_UART_CONSOLE_INDEX));
 }
 
+void UARTClass::getTxStats( UARTTxStats *stats )
+{
+  stats->droppedBytes = _txStats.droppedBytes;
+  stats->spinMicros = _txStats.spinMicros;
+  stats->peakOccupancy = _txStats.peakOccupancy;
+}
+
+void UARTClass::resetTxStats( void )
+{
+  _txStats.droppedBytes = 0;
+  _txStats.spinMicros = 0;
+  _txStats.peakOccupancy = 0;
+}
+
+// Returns true once the TX ring has room, or false straight away in
+// non-blocking mode
+bool UARTClass::waitForTxSpace( void )
+{
+  if (!_tx_buffer->isFull())
+    return true;
+  if (_txNonBlocking)
+    return false;
+
+  uint32_t start = micros();
+  while (_tx_buffer->isFull()); // Spin locks if we're about to overwrite the buffer. This continues once the data is sent
+  _txStats.spinMicros += micros() - start;
+  return true;
+}
+
+void UARTClass::startTx( void )
+{
+  if (_dmaEnabled)
+    dmaTxKick();
+  else
+    // Make sure TX interrupt is enabled
+    uart_irq_tx_enable(CONFIG_UART_CONSOLE_INDEX);
+}
+
+void UARTClass::updateTxPeak( void )
+{
+  uint32_t occupancy = _tx_buffer->available();
+  if (occupancy > _txStats.peakOccupancy)
+    _txStats.peakOccupancy = occupancy;
+}
+
 size_t UARTClass::write( const uint8_t uc_data )
 {
   if (!opened)
     return(0);
 
   // Is the hardware currently busy?
-  if (_tx_buffer->_iTail != _tx_buffer->_iHead)
+  if (_dmaEnabled || !_tx_buffer->isEmpty() || !uart_tx_ready(CONFIG_UART_CONSOLE_INDEX))
   {
     // If busy we buffer
-    int l = (_tx_buffer->_iHead + 1) % UART_BUFFER_SIZE;
-    while (_tx_buffer->_iTail == l); // Spin locks if we're about to overwrite the buffer. This continues once the data is sent
+    if (!waitForTxSpace())
+    {
+      _txStats.droppedBytes++;
+      return 0;
+    }
 
-    _tx_buffer->_aucBuffer[_tx_buffer->_iHead] = uc_data;
-    _tx_buffer->_iHead = l;
-    // Make sure TX interrupt is enabled
-    uart_irq_tx_enable(CONFIG_UART_CONSOLE_INDEX);
+    _tx_buffer->store_char(uc_data);
+    updateTxPeak();
+    startTx();
   }
   else 
   {
@@ -198,6 +270,245 @@ size_t UARTClass::write( const uint8_t uc_data )
   return 1;
 }
 
+size_t UARTClass::write( const uint8_t *buffer, size_t size )
+{
+  size_t sent = 0;
+
+  if (!opened)
+    return(0);
+
+  // If the transmitter is idle, prime the FIFO straight from the caller's
+  // buffer; the TX interrupt picks up the rest from the ring
+  if (!_dmaEnabled && _tx_buffer->isEmpty())
+    sent = uart_fifo_fill(CONFIG_UART_CONSOLE_INDEX, buffer, min(size, (size_t)UART_FIFO_SIZE));
+
+  while (sent < size)
+  {
+    // Wait (or give up) until the interrupt handler has made room
+    if (!waitForTxSpace())
+    {
+      _txStats.droppedBytes += size - sent;
+      break;
+    }
+    sent += _tx_buffer->push(buffer + sent, size - sent);
+    updateTxPeak();
+    startTx();
+  }
+  return sent;
+}
+
+size_t UARTClass::readBytes( char *buffer, size_t length )
+{
+  // Drain whatever is already buffered in one go, then wait for the rest
+  // with the same per-character timeout as Stream::readBytes()
+  if (_dmaEnabled)
+    dmaRxPoll();
+  size_t count = _rx_buffer->pop((uint8_t *)buffer, length);
+
+  _startMillis = millis();
+  while (count < length)
+  {
+    if (_dmaEnabled)
+      dmaRxPoll();
+    size_t n = _rx_buffer->pop((uint8_t *)buffer + count, length - count);
+    if (n)
+    {
+      count += n;
+      _startMillis = millis();
+    }
+    else if (millis() - _startMillis >= _timeout)
+    {
+      break;
+    }
+  }
+  return count;
+}
+
+bool UARTClass::enableDMA( uint16_t rxBufferSize )
+{
+  uint32_t half;
+
+  if (!opened || _dmaEnabled)
+    return false;
+
+  // The TX ring becomes the DMA source, so it must be drained and moved
+  // out of DCCM, which the DMA controller cannot reach
+  flush();
+  uart_irq_rx_disable(CONFIG_UART_CONSOLE_INDEX);
+  uart_irq_tx_disable(CONFIG_UART_CONSOLE_INDEX);
+
+  half = (rxBufferSize + 1) / 2;
+  _dmaRxSize = half * 2;
+  _dmaRxBuffer = (uint8_t *)malloc(_dmaRxSize);
+  if (_dmaRxBuffer == NULL || !_tx_buffer->allocate(_tx_buffer->capacity(), true))
+    goto fail;
+
+  dma_shared_init();
+  if (soc_dma_acquire(&_dmaRxChannel) != DRV_RC_OK)
+    goto fail;
+  if (soc_dma_acquire(&_dmaTxChannel) != DRV_RC_OK)
+  {
+    soc_dma_release(&_dmaRxChannel);
+    goto fail;
+  }
+
+  // Receive: endless circular list of two halves, so the block interrupt
+  // fires once per half and lets us spot a lapped buffer
+  memset(&_dmaRxCfg, 0, sizeof(_dmaRxCfg));
+  _dmaRxCfg.type = SOC_DMA_TYPE_PER2MEM;
+  _dmaRxCfg.src_interface = UART_DMA_RX_INTERFACE;
+  _dmaRxCfg.xfer.src.delta = SOC_DMA_DELTA_NONE;
+  _dmaRxCfg.xfer.src.width = SOC_DMA_WIDTH_8;
+  _dmaRxCfg.xfer.src.addr = (void *)info->regs;
+  _dmaRxCfg.xfer.dest.delta = SOC_DMA_DELTA_INCR;
+  _dmaRxCfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+  _dmaRxCfg.xfer.dest.addr = _dmaRxBuffer;
+  _dmaRxCfg.xfer.size = half;
+  _dmaRxHalf = _dmaRxCfg.xfer;
+  _dmaRxHalf.dest.addr = _dmaRxBuffer + half;
+  _dmaRxHalf.next = &_dmaRxCfg.xfer;
+  _dmaRxCfg.xfer.next = &_dmaRxHalf;
+  _dmaRxCfg.cb_block = dmaRxBlock;
+  _dmaRxCfg.cb_block_arg = this;
+  _dmaRxCfg.cb_err = dmaRxError;
+  _dmaRxCfg.cb_err_arg = this;
+
+  // Transmit: one list item, re-pointed at the TX ring for every block
+  memset(&_dmaTxCfg, 0, sizeof(_dmaTxCfg));
+  _dmaTxCfg.type = SOC_DMA_TYPE_MEM2PER;
+  _dmaTxCfg.dest_interface = UART_DMA_TX_INTERFACE;
+  _dmaTxCfg.xfer.src.delta = SOC_DMA_DELTA_INCR;
+  _dmaTxCfg.xfer.src.width = SOC_DMA_WIDTH_8;
+  _dmaTxCfg.xfer.dest.delta = SOC_DMA_DELTA_NONE;
+  _dmaTxCfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+  _dmaTxCfg.xfer.dest.addr = (void *)info->regs;
+  _dmaTxCfg.cb_done = dmaTxDone;
+  _dmaTxCfg.cb_done_arg = this;
+  _dmaTxCfg.cb_err = dmaTxDone;
+  _dmaTxCfg.cb_err_arg = this;
+
+  _dmaRxTail = 0;
+  _dmaRxBlocks = 0;
+  _dmaRxBlocksSeen = 0;
+  _dmaRxOverruns = 0;
+  _dmaTxLen = 0;
+
+  if (soc_dma_config(&_dmaRxChannel, &_dmaRxCfg) != DRV_RC_OK ||
+      soc_dma_start_transfer(&_dmaRxChannel) != DRV_RC_OK)
+  {
+    soc_dma_release(&_dmaRxChannel);
+    soc_dma_release(&_dmaTxChannel);
+    goto fail;
+  }
+
+  _dmaEnabled = true;
+  return true;
+
+fail:
+  free(_dmaRxBuffer);
+  _dmaRxBuffer = NULL;
+  uart_irq_rx_enable(CONFIG_UART_CONSOLE_INDEX);
+  return false;
+}
+
+void UARTClass::disableDMA( void )
+{
+  if (!_dmaEnabled)
+    return;
+
+  // Let pending output go out, and keep whatever has been received
+  flush();
+  dmaRxPoll();
+
+  soc_dma_stop_transfer(&_dmaRxChannel);
+  soc_dma_release(&_dmaRxChannel);
+  soc_dma_stop_transfer(&_dmaTxChannel);
+  soc_dma_release(&_dmaTxChannel);
+
+  _dmaEnabled = false;
+  free(_dmaRxBuffer);
+  _dmaRxBuffer = NULL;
+
+  uart_irq_rx_enable(CONFIG_UART_CONSOLE_INDEX);
+}
+
+// Move whatever the RX DMA has written since the last call into the RX ring
+void UARTClass::dmaRxPoll( void )
+{
+  uint32_t head = dma_get_dest_addr(&_dmaRxChannel) - (uint32_t)_dmaRxBuffer;
+  uint32_t blocks = _dmaRxBlocks;
+
+  // Crossing more than two half boundaries means a full lap of the buffer
+  if (blocks - _dmaRxBlocksSeen > 2)
+    _dmaRxOverruns++;
+  _dmaRxBlocksSeen = blocks;
+
+  if (head >= _dmaRxSize)
+    head = 0;
+
+  while (_dmaRxTail != head)
+  {
+    uint32_t end = (head > _dmaRxTail) ? head : _dmaRxSize;
+    size_t n = _rx_buffer->push(_dmaRxBuffer + _dmaRxTail, end - _dmaRxTail);
+    if (n == 0)
+      break;  // RX ring full, leave the rest in the DMA buffer
+    _dmaRxTail += n;
+    if (_dmaRxTail == _dmaRxSize)
+      _dmaRxTail = 0;
+  }
+}
+
+// Start a TX DMA block for the contiguous part of the TX ring, if idle
+void UARTClass::dmaTxKick( void )
+{
+  uint32_t saved = interrupt_lock();
+
+  if (_dmaTxLen == 0)
+  {
+    const uint8_t *data;
+    size_t len = _tx_buffer->readSpan(&data);
+
+    if (len)
+    {
+      _dmaTxCfg.xfer.src.addr = (void *)data;
+      _dmaTxCfg.xfer.size = len;
+      soc_dma_deconfig(&_dmaTxChannel);
+      if (soc_dma_config(&_dmaTxChannel, &_dmaTxCfg) == DRV_RC_OK &&
+          soc_dma_start_transfer(&_dmaTxChannel) == DRV_RC_OK)
+        _dmaTxLen = len;
+    }
+  }
+
+  interrupt_unlock(saved);
+}
+
+void UARTClass::dmaRxBlock( void *arg )
+{
+  UARTClass *uart = (UARTClass *)arg;
+  uart->_dmaRxBlocks++;
+}
+
+void UARTClass::dmaRxError( void *arg )
+{
+  UARTClass *uart = (UARTClass *)arg;
+
+  // The channel restarts from the top of the buffer, anything unread is lost
+  uart->_dmaRxOverruns++;
+  uart->_dmaRxTail = 0;
+  soc_dma_start_transfer(&uart->_dmaRxChannel);
+}
+
+void UARTClass::dmaTxDone( void *arg )
+{
+  UARTClass *uart = (UARTClass *)arg;
+
+  uart->_tx_buffer->consume(uart->_dmaTxLen);
+  uart->_dmaTxLen = 0;
+  uart->dmaTxKick();
+  if (uart->_dmaTxLen == 0 && uart->_txDrainedCallback)
+    uart->_txDrainedCallback();
+}
+
 void UARTClass::IrqHandler( void )
 {
   uart_irq_update(CONFIG_UART_CONSOLE_INDEX);
@@ -217,17 +528,19 @@ void UARTClass::IrqHandler( void )
   // if irq is Transmitter Holding Register
   if(uart_irq_tx_ready(CONFIG_UART_CONSOLE_INDEX))
   {
-    if(_tx_buffer->_iTail != _tx_buffer->_iHead)
+    const uint8_t *data;
+    int l = _tx_buffer->readSpan(&data);
+    if(l)
     {
-      int end = (_tx_buffer->_iTail < _tx_buffer->_iHead) ? _tx_buffer->_iHead : UART_BUFFER_SIZE;
-      int l = min(end - _tx_buffer->_iTail, UART_FIFO_SIZE);
-      l = uart_fifo_fill(CONFIG_UART_CONSOLE_INDEX, _tx_buffer->_aucBuffer+_tx_buffer->_iTail, l);
-      _tx_buffer->_iTail = (_tx_buffer->_iTail+l)%UART_BUFFER_SIZE;
+      l = uart_fifo_fill(CONFIG_UART_CONSOLE_INDEX, data, min(l, UART_FIFO_SIZE));
+      _tx_buffer->consume(l);
     }
     else
     {
       // Mask off transmit interrupt so we don't get it anymore
       uart_irq_tx_disable(CONFIG_UART_CONSOLE_INDEX);
+      if (_txDrainedCallback)
+        _txDrainedCallback();
     }
   }
 }
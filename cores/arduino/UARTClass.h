@@ -24,6 +24,10 @@
 
 #include <board.h>
 #include <uart.h>
+#include <soc_dma.h>
+
+// Default size of the circular receive buffer used in DMA mode
+#define UART_DMA_RX_BUFFER_SIZE 1024
 
 #define SERIAL_5N1      LCR_CS5 | LCR_PDIS | LCR_1_STB
 #define SERIAL_6N1      LCR_CS6 | LCR_PDIS | LCR_1_STB
@@ -50,12 +54,25 @@
 #define SERIAL_7O2      LCR_CS7 | LCR_PEN  | LCR_2_STB
 #define SERIAL_8O2      LCR_CS8 | LCR_PEN  | LCR_2_STB
 
+// Transmit-side backpressure counters, see UARTClass::getTxStats()
+struct UARTTxStats
+{
+    uint32_t droppedBytes;  // bytes refused in non-blocking mode
+    uint32_t spinMicros;    // time spent waiting for ring space in blocking mode
+    uint32_t peakOccupancy; // highest number of bytes queued in the TX ring
+};
+
 class UARTClass : public HardwareSerial
 {
   public:
     //UARTClass(Uart* pUart, IRQn_Type dwIrq, uint32_t dwId, RingBuffer* pRx_buffer, RingBuffer* pTx_buffer);
     UARTClass(uart_init_info *info, RingBuffer *pRx_buffer, RingBuffer *pTx_buffer );
 
+    // Resize the receive/transmit rings (rounded up to a power of two).
+    // Only allowed while the port is closed, i.e. before begin().
+    bool setRxBufferSize(uint16_t size);
+    bool setTxBufferSize(uint16_t size);
+
     void begin(const uint32_t dwBaudRate);
     void begin(const uint32_t dwBaudRate, const uint8_t config);
     void end(void);
@@ -65,7 +82,25 @@ class UARTClass : public HardwareSerial
     int read(void);
     void flush(void);
     size_t write(const uint8_t c);
-    using Print::write; // pull in write(str) and write(buf, size) from Print
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write; // pull in write(str) from Print
+    size_t readBytes(char *buffer, size_t length);
+    using Stream::readBytes; // pull in readBytes(uint8_t *, size) from Stream
+    // In non-blocking mode write() never waits for ring space and returns
+    // the number of bytes actually queued
+    void setTxNonBlocking(bool enable) { _txNonBlocking = enable; }
+    bool getTxNonBlocking(void) { return _txNonBlocking; }
+    // Called from the interrupt handler once the TX ring has been emptied
+    void onTxDrained(void (*callback)(void)) { _txDrainedCallback = callback; }
+    void getTxStats(UARTTxStats *stats);
+    void resetTxStats(void);
+    // DMA mode: received data is streamed by DMA into a circular SRAM buffer
+    // and transmitted by DMA straight out of the TX ring, so the CPU only
+    // does per-block instead of per-FIFO work.  Call after begin().
+    bool enableDMA(uint16_t rxBufferSize = UART_DMA_RX_BUFFER_SIZE);
+    void disableDMA(void);
+    bool isDMAEnabled(void) { return _dmaEnabled; }
+    uint32_t getDMARxOverruns(void) { return _dmaRxOverruns; }
     void setInterruptPriority(uint32_t priority);
     uint32_t getInterruptPriority();
 
@@ -75,6 +110,14 @@ class UARTClass : public HardwareSerial
 
   protected:
     void init(const uint32_t dwBaudRate, const uint8_t config);
+    bool waitForTxSpace(void);
+    void updateTxPeak(void);
+    void startTx(void);
+    void dmaRxPoll(void);
+    void dmaTxKick(void);
+    static void dmaRxBlock(void *arg);
+    static void dmaRxError(void *arg);
+    static void dmaTxDone(void *arg);
 
     RingBuffer *_rx_buffer;
     RingBuffer *_tx_buffer;
@@ -85,6 +128,24 @@ class UARTClass : public HardwareSerial
     uint32_t _dwId;
     uint32_t opened;
 
+    bool _txNonBlocking;
+    void (*_txDrainedCallback)(void);
+    volatile UARTTxStats _txStats;
+
+    bool _dmaEnabled;
+    struct soc_dma_channel _dmaRxChannel;
+    struct soc_dma_channel _dmaTxChannel;
+    struct soc_dma_cfg _dmaRxCfg;
+    struct soc_dma_cfg _dmaTxCfg;
+    struct soc_dma_xfer_item _dmaRxHalf;
+    uint8_t *_dmaRxBuffer;
+    uint32_t _dmaRxSize;
+    uint32_t _dmaRxTail;
+    volatile uint32_t _dmaRxBlocks;
+    uint32_t _dmaRxBlocksSeen;
+    volatile uint32_t _dmaRxOverruns;
+    volatile uint32_t _dmaTxLen;
+
 };
 
 #endif // _UART_CLASS_
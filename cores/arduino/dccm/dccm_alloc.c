@@ -19,31 +19,184 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "dccm_alloc.h"
 
-uint16_t dccm_index = 0;
+/*
+ * DCCM is only 8K, so the heap is kept as a plain sequence of blocks, each
+ * starting with a 4 byte header. Allocation is first-fit; free() merges a
+ * block with its free neighbours so the region never splinters into blocks
+ * smaller than what was handed out.
+ */
+
+#define DCCM_HDR_SIZE   4
+#define DCCM_MIN_BLOCK  8
+#define DCCM_TAG_FREE   0xF4EE
+#define DCCM_TAG_USED   0xA110
+
+typedef struct {
+    uint16_t size;      /* whole block, header included */
+    uint16_t tag;
+} dccm_block_t;
+
+static uint8_t *dccm_base = 0;
+static uint16_t dccm_size = 0;
+static uint16_t dccm_used = 0;
+static uint16_t dccm_high_water = 0;
+
+#define DCCM_NEXT(b)    ((dccm_block_t*)((uint8_t*)(b) + (b)->size))
+#define DCCM_END()      ((dccm_block_t*)(dccm_base + dccm_size))
 
 #ifdef __cplusplus
  extern "C" {
 #endif
 
-void* dccm_malloc(uint16_t size)
+void dccm_init(void *base, uint16_t size)
 {
-    if((size + dccm_index) > DCCM_SIZE)
+    uintptr_t start = ((uintptr_t)base + 3) & ~((uintptr_t)0x3);
+    uint16_t skew = (uint16_t)(start - (uintptr_t)base);
+
+    dccm_base = (uint8_t*)start;
+    dccm_size = (size > skew) ? ((size - skew) & ~((uint16_t)0x3)) : 0;
+    dccm_used = 0;
+    dccm_high_water = 0;
+
+    if (dccm_size < DCCM_MIN_BLOCK)
     {
+        dccm_size = 0;
+        return;
+    }
+
+    dccm_block_t *first = (dccm_block_t*)dccm_base;
+    first->size = dccm_size;
+    first->tag = DCCM_TAG_FREE;
+}
+
+static dccm_block_t *dccm_first(void)
+{
+    if (dccm_base == 0)
+        dccm_init((void*)DCCM_START, DCCM_SIZE);
+    return (dccm_block_t*)dccm_base;
+}
+
+/* Cut 'b' down to 'size' bytes, turning the remainder into a free block */
+static void dccm_split(dccm_block_t *b, uint16_t size)
+{
+    dccm_block_t *rest = (dccm_block_t*)((uint8_t*)b + size);
+    rest->size = b->size - size;
+    rest->tag = DCCM_TAG_FREE;
+    b->size = size;
+}
+
+void *dccm_aligned_alloc(uint16_t align, uint16_t size)
+{
+    if (align < 4)
+        align = 4;
+    if (align & (align - 1))
         return 0;
+
+    uint32_t need = (((uint32_t)size + 3) & ~0x3UL) + DCCM_HDR_SIZE;
+    if (need < DCCM_MIN_BLOCK)
+        need = DCCM_MIN_BLOCK;
+
+    dccm_block_t *b;
+    for (b = dccm_first(); b < DCCM_END(); b = DCCM_NEXT(b))
+    {
+        if (b->tag != DCCM_TAG_FREE)
+            continue;
+
+        /* Any gap in front of the aligned payload must be able to hold a
+         * free block of its own */
+        uintptr_t payload = ((uintptr_t)b + DCCM_HDR_SIZE + align - 1) & ~((uintptr_t)align - 1);
+        uint32_t lead = payload - DCCM_HDR_SIZE - (uintptr_t)b;
+        while (lead != 0 && lead < DCCM_MIN_BLOCK)
+            lead += align;
+        if (lead + need > b->size)
+            continue;
+
+        if (lead)
+        {
+            dccm_split(b, (uint16_t)lead);
+            b = DCCM_NEXT(b);
+        }
+        if (b->size - need >= DCCM_MIN_BLOCK)
+            dccm_split(b, (uint16_t)need);
+
+        b->tag = DCCM_TAG_USED;
+        dccm_used += b->size;
+        if (dccm_used > dccm_high_water)
+            dccm_high_water = dccm_used;
+        return (uint8_t*)b + DCCM_HDR_SIZE;
     }
-    
-    void* addr = (void*)(DCCM_START + dccm_index);
-    dccm_index += size;
-    return addr;
+
+    return 0;
+}
+
+void* dccm_malloc(uint16_t size)
+{
+    return dccm_aligned_alloc(4, size);
 }
 
 void *dccm_memalign(uint16_t size)
 {
-  if ((dccm_index +3) > DCCM_SIZE)
-    return 0;
+    return dccm_aligned_alloc(4, size);
+}
 
-  dccm_index = (dccm_index + 3) & ~((uint16_t)0x3);  /* 4 byte addr alignment */
-  return dccm_malloc(size);
+int dccm_owns(const void *ptr)
+{
+    const uint8_t *p = (const uint8_t*)ptr;
+    return (dccm_base != 0) && (p >= dccm_base + DCCM_HDR_SIZE) &&
+           (p < dccm_base + dccm_size);
+}
+
+void dccm_free(void *ptr)
+{
+    if (!dccm_owns(ptr))
+        return;
+
+    /* Walk to the block rather than trusting the header in front of 'ptr',
+     * so stray pointers are ignored and the previous block is known */
+    dccm_block_t *target = (dccm_block_t*)((uint8_t*)ptr - DCCM_HDR_SIZE);
+    dccm_block_t *prev = 0;
+    dccm_block_t *b;
+    for (b = dccm_first(); b < target; b = DCCM_NEXT(b))
+        prev = b;
+    if (b != target || b->tag != DCCM_TAG_USED)
+        return;
+
+    b->tag = DCCM_TAG_FREE;
+    dccm_used -= b->size;
+
+    dccm_block_t *next = DCCM_NEXT(b);
+    if (next < DCCM_END() && next->tag == DCCM_TAG_FREE)
+        b->size += next->size;
+    if (prev != 0 && prev->tag == DCCM_TAG_FREE)
+        prev->size += b->size;
+}
+
+void dccm_get_stats(struct dccm_stats *stats)
+{
+    stats->used = 0;
+    stats->free = 0;
+    stats->largestFree = 0;
+    stats->freeBlocks = 0;
+    stats->usedBlocks = 0;
+
+    dccm_block_t *b;
+    for (b = dccm_first(); b < DCCM_END(); b = DCCM_NEXT(b))
+    {
+        if (b->tag == DCCM_TAG_USED)
+        {
+            stats->used += b->size;
+            stats->usedBlocks++;
+            continue;
+        }
+        /* A free block can only ever hand out its payload */
+        uint16_t avail = b->size - DCCM_HDR_SIZE;
+        stats->free += avail;
+        stats->freeBlocks++;
+        if (avail > stats->largestFree)
+            stats->largestFree = avail;
+    }
+    stats->total = dccm_size;
+    stats->highWater = dccm_high_water;
 }
 
 #ifdef __cplusplus
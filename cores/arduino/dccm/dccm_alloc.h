@@ -19,8 +19,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <stdint.h>
 
+#ifndef DCCM_START
 #define DCCM_START  0x80000000
+#endif
+#ifndef DCCM_SIZE
 #define DCCM_SIZE 8192
+#endif
 
 #ifndef _DCCM_ALLOC_
 #define _DCCM_ALLOC_
@@ -29,10 +33,41 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  extern "C" {
 #endif
 
+/* Snapshot of the DCCM heap, all sizes in bytes (block headers included in
+ * 'used'). 'highWater' is the peak of 'used' since the heap was set up. */
+struct dccm_stats {
+    uint16_t total;
+    uint16_t used;
+    uint16_t free;
+    uint16_t largestFree;
+    uint16_t highWater;
+    uint16_t freeBlocks;
+    uint16_t usedBlocks;
+};
+
+/* Allocations are 4 byte aligned and can be given back with dccm_free().
+ * The allocators return 0 once DCCM is exhausted; callers are expected to
+ * fall back to malloc(). None of these functions are interrupt safe. */
 void* dccm_malloc(uint16_t size);
 
 void *dccm_memalign(uint16_t size);
 
+/* 'align' must be a power of two; values below 4 are rounded up to 4 */
+void *dccm_aligned_alloc(uint16_t align, uint16_t size);
+
+/* Freeing 0 is a no-op, so is freeing a pointer dccm_malloc() did not return */
+void dccm_free(void *ptr);
+
+/* Returns 1 if 'ptr' lies inside the DCCM heap */
+int dccm_owns(const void *ptr);
+
+void dccm_get_stats(struct dccm_stats *stats);
+
+/* (Re)initialise the heap over an arbitrary region, dropping every previous
+ * allocation. Only needed to run the allocator against a simulated region
+ * on a host; on target the heap sets itself up over DCCM on first use. */
+void dccm_init(void *base, uint16_t size);
+
 #ifdef __cplusplus
 }
 #endif
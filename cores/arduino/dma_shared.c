@@ -0,0 +1,203 @@
+/*
+ * dma_shared.c - sharing the SoC DMA controller between the core and
+ *                libraries
+ *
+ * Copyright (C) 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The soc_dma driver comes prebuilt in libarc32drv_arduino101.a, so
+ * rather than patching it this file swaps in its own interrupt handlers
+ * through g_dma_info before the driver installs them. Only the driver's
+ * public API is used to stop a channel; the few controller registers read
+ * here are repeated from soc_dma_priv.h, which defines data of its own and
+ * cannot be included a second time.
+ */
+
+#include "dma_shared.h"
+#include "scss_registers.h"
+#include "portable.h"
+
+/* Per channel register block, and the interrupt registers */
+#define DMA_CH_STRIDE           (0x058)
+#define DMA_SAR(id)             ((id) * DMA_CH_STRIDE)
+#define DMA_DAR(id)             (0x008 + (id) * DMA_CH_STRIDE)
+#define DMA_STATUS_TFR          (0x2E8)
+#define DMA_STATUS_BLOCK        (0x2F0)
+#define DMA_STATUS_ERR          (0x308)
+#define DMA_CLEAR_TFR           (0x338)
+#define DMA_CLEAR_BLOCK         (0x340)
+#define DMA_CLEAR_ERR           (0x358)
+
+#define DMA_REG(offset)         MMIO_REG_VAL_FROM_BASE(SOC_DMA_BASE, offset)
+
+/* Linked list item as built by soc_dma_config() (struct dma_lli) */
+struct dma_shared_lli {
+    uint32_t sar;
+    uint32_t dar;
+    uint32_t llp;
+    uint32_t ctl_l;
+    uint32_t ctl_u;
+    uint32_t dstat;
+    uint32_t sstat;
+    uint8_t end_group;
+};
+
+extern struct soc_dma_info g_dma_info;
+
+static uint8_t dma_shared_ready;
+
+static void dma_shared_clear(uint32_t id)
+{
+    DMA_REG(DMA_CLEAR_TFR) = 1 << id;
+    DMA_REG(DMA_CLEAR_BLOCK) = 1 << id;
+    DMA_REG(DMA_CLEAR_ERR) = 1 << id;
+}
+
+static void dma_shared_channel_isr(uint32_t id)
+{
+    struct soc_dma_channel *channel = g_dma_info.channel[id];
+    struct dma_shared_lli *curr;
+
+    if (!channel) {
+        /* Released with an interrupt still pending */
+        dma_shared_clear(id);
+        return;
+    }
+
+    if (DMA_REG(DMA_STATUS_TFR) & (1 << id)) {
+        /* Off before the callback, which may release the channel or
+         * configure and start the next transfer on it */
+        soc_dma_stop_transfer(channel);
+        if (channel->cfg.cb_done)
+            channel->cfg.cb_done(channel->cfg.cb_done_arg);
+    } else if (DMA_REG(DMA_STATUS_BLOCK) & (1 << id)) {
+        curr = (struct dma_shared_lli *)channel->curr;
+        if (curr && curr->end_group && channel->cfg.cb_block)
+            channel->cfg.cb_block(channel->cfg.cb_block_arg);
+
+        /* The callback may have released the channel */
+        if (g_dma_info.channel[id] == channel && curr)
+            channel->curr = (void *)curr->llp;
+        DMA_REG(DMA_CLEAR_BLOCK) = 1 << id;
+    }
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_shared_ch0_isr()
+{
+    dma_shared_channel_isr(0);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_shared_ch1_isr()
+{
+    dma_shared_channel_isr(1);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_shared_ch2_isr()
+{
+    dma_shared_channel_isr(2);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_shared_ch3_isr()
+{
+    dma_shared_channel_isr(3);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_shared_ch4_isr()
+{
+    dma_shared_channel_isr(4);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_shared_ch5_isr()
+{
+    dma_shared_channel_isr(5);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_shared_ch6_isr()
+{
+    dma_shared_channel_isr(6);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_shared_ch7_isr()
+{
+    dma_shared_channel_isr(7);
+}
+
+DECLARE_INTERRUPT_HANDLER static void dma_shared_err_isr()
+{
+    uint32_t reg = DMA_REG(DMA_STATUS_ERR);
+    struct soc_dma_channel *channel;
+    uint32_t id;
+
+    for (id = 0; id < SOC_DMA_NUM_CHANNELS; id++) {
+        if (!(reg & (1 << id)))
+            continue;
+
+        channel = g_dma_info.channel[id];
+        if (!channel) {
+            dma_shared_clear(id);
+            continue;
+        }
+
+        /* As for completion, off first so the callback may restart it */
+        soc_dma_stop_transfer(channel);
+        if (channel->cfg.cb_err)
+            channel->cfg.cb_err(channel->cfg.cb_err_arg);
+    }
+}
+
+static const isr_func dma_shared_isr[SOC_DMA_NUM_CHANNELS] = {
+    dma_shared_ch0_isr,
+    dma_shared_ch1_isr,
+    dma_shared_ch2_isr,
+    dma_shared_ch3_isr,
+    dma_shared_ch4_isr,
+    dma_shared_ch5_isr,
+    dma_shared_ch6_isr,
+    dma_shared_ch7_isr
+};
+
+void dma_shared_init(void)
+{
+    uint32_t saved;
+    int i;
+
+    saved = interrupt_lock();
+    if (dma_shared_ready) {
+        interrupt_unlock(saved);
+        return;
+    }
+    dma_shared_ready = 1;
+
+    /* soc_dma_init() connects whatever g_dma_info lists */
+    for (i = 0; i < SOC_DMA_NUM_CHANNELS; i++)
+        g_dma_info.int_handler[i] = dma_shared_isr[i];
+    soc_dma_init();
+    SET_INTERRUPT_HANDLER(g_dma_info.err_vector, dma_shared_err_isr);
+    interrupt_unlock(saved);
+}
+
+uint32_t dma_get_dest_addr(const struct soc_dma_channel *channel)
+{
+    return DMA_REG(DMA_DAR(channel->id));
+}
+
+uint32_t dma_get_src_addr(const struct soc_dma_channel *channel)
+{
+    return DMA_REG(DMA_SAR(channel->id));
+}
@@ -0,0 +1,51 @@
+/*
+ * dma_shared.h - sharing the SoC DMA controller between the core and
+ *                libraries
+ *
+ * Copyright (C) 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef dma_shared_h
+#define dma_shared_h
+
+#include <inttypes.h>
+#include "soc_dma.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * Use instead of soc_dma_init(). The soc_dma driver resets the controller,
+ * and with it every channel in use, each time it is initialized; it only
+ * has interrupt handlers for channels 0 and 1; and it turns a channel off
+ * after the done or error callback, stopping a transfer the callback just
+ * started. The first call initializes the controller and installs handlers
+ * for all channels that turn a channel off before its callback runs, so a
+ * callback may restart it. Later calls do nothing.
+ */
+void dma_shared_init(void);
+
+/* Where a channel writes to, or reads from, next */
+uint32_t dma_get_dest_addr(const struct soc_dma_channel *channel);
+uint32_t dma_get_src_addr(const struct soc_dma_channel *channel);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* dma_shared_h */
@@ -20,10 +20,49 @@
  */
 
 #include "i2c.h"
+#include "i2c_async.h"
+#include "i2c_recovery.h"
+#include "interrupt.h"
+#include "portable.h"
 #include "variant.h"
+#include "wiring_constants.h"
+#include "wiring_digital.h"
 
 #define TIMEOUT_MS 16
 
+/* Controller registers, repeated from i2c_priv.h, which the core cannot
+ * include; the prebuilt driver has no call to change the timing alone */
+#define I2C_REG_BASE(id)        ((id) == I2C_SENSING_0 ? 0x80012000 : 0x80012100)
+#define I2C_REG_CON             (0x00)
+#define I2C_REG_SS_SCL_CNT      (0x02)
+#define I2C_REG_FS_SCL_CNT      (0x04)
+#define I2C_REG_STATUS          (0x0b)
+#define I2C_CON_ENABLE          (1 << 0)
+#define I2C_CON_TIMING_MASK     ((0xff << 22) | (0x3 << 3))
+#define I2C_STATUS_ACTIVITY     (0x01)
+#define I2C_STATUS_TFE          (0x04)
+#define I2C_STATUS_MASTER_ACT   (0x20)
+
+/* What the driver configures on open, see i2c_priv.h */
+static const struct i2c_timing i2c_timing_slow = { I2C_SLOW, 0x05, 0x008A, 0x009D };
+static const struct i2c_timing i2c_timing_fast = { I2C_FAST, 0x05, 0x0013, 0x0027 };
+
+static struct i2c_device_clock {
+    uint8_t used;
+    uint8_t addr;
+    struct i2c_timing timing;
+} i2c_device_clock[NUM_SS_I2C][I2C_SPEED_PROFILES];
+static struct i2c_timing i2c_bus_timing[NUM_SS_I2C];
+static struct i2c_timing i2c_loaded_timing[NUM_SS_I2C];
+static bool i2c_bus_held[NUM_SS_I2C];
+
+static int i2c_open_speed[NUM_SS_I2C] = { I2C_SLOW, I2C_SLOW };
+static bool i2c_bus_stuck[NUM_SS_I2C];
+static uint8_t i2c_retries[NUM_SS_I2C] = { I2C_RETRIES, I2C_RETRIES };
+static uint32_t i2c_backoff_us[NUM_SS_I2C] = { I2C_BACKOFF_US, I2C_BACKOFF_US };
+static struct i2c_stats i2c_stats[NUM_SS_I2C][I2C_STATS_DEVICES + 1];
+static uint8_t i2c_stats_used[NUM_SS_I2C];
+
 static volatile uint8_t i2c_tx_complete[NUM_SS_I2C];
 static volatile uint8_t i2c_rx_complete[NUM_SS_I2C];
 static volatile uint8_t i2c_err_detect[NUM_SS_I2C];
@@ -34,38 +73,49 @@ static volatile uint8_t i2c_slave[NUM_SS_I2C];
 static void ss_i2c_0_rx(uint32_t dev_id)
 {
     i2c_rx_complete[I2C_SENSING_0] = 1;
+    i2c_async_done(I2C_SENSING_0);
 }
 
 static void ss_i2c_1_rx(uint32_t dev_id)
 {
     i2c_rx_complete[I2C_SENSING_1] = 1;
+    i2c_async_done(I2C_SENSING_1);
 }
 
 static void ss_i2c_0_tx(uint32_t dev_id)
 {
     i2c_tx_complete[I2C_SENSING_0] = 1;
+    i2c_async_done(I2C_SENSING_0);
 }
 
 static void ss_i2c_1_tx(uint32_t dev_id)
 {
     i2c_tx_complete[I2C_SENSING_1] = 1;
+    i2c_async_done(I2C_SENSING_1);
 }
 
 static void ss_i2c_0_err(uint32_t dev_id)
 {
     i2c_err_detect[I2C_SENSING_0] = 1;
     i2c_err_source[I2C_SENSING_0] = dev_id;
+    /* An abort ends with a STOP, held or not */
+    i2c_bus_held[I2C_SENSING_0] = false;
+    i2c_async_error(I2C_SENSING_0, dev_id);
 }
 
 static void ss_i2c_1_err(uint32_t dev_id)
 {
     i2c_err_detect[I2C_SENSING_1] = 1;
     i2c_err_source[I2C_SENSING_1] = dev_id;
+    /* An abort ends with a STOP, held or not */
+    i2c_bus_held[I2C_SENSING_1] = false;
+    i2c_async_error(I2C_SENSING_1, dev_id);
 }
 
-static int wait_rx_or_err(I2C_CONTROLLER controller_id)
+static int wait_rx_or_err(I2C_CONTROLLER controller_id, uint32_t length)
 {
-    uint64_t timeout = TIMEOUT_MS * 200;
+    /* Allow ~100us per byte on top, a byte takes 90us at 100kHz */
+    uint64_t timeout = TIMEOUT_MS * 200 + (uint64_t)length * 10;
 
     while (timeout--) {
         if (i2c_err_detect[controller_id]) {
@@ -86,9 +136,10 @@ static int wait_rx_or_err(I2C_CONTROLLER controller_id)
     return I2C_TIMEOUT;
 }
 
-static int wait_tx_or_err(I2C_CONTROLLER controller_id)
+static int wait_tx_or_err(I2C_CONTROLLER controller_id, uint32_t length)
 {
-    uint64_t timeout = TIMEOUT_MS * 200;
+    /* Allow ~100us per byte on top, a byte takes 90us at 100kHz */
+    uint64_t timeout = TIMEOUT_MS * 200 + (uint64_t)length * 10;
 
     while (timeout--) {
         if (i2c_err_detect[controller_id]) {
@@ -164,8 +215,12 @@ int i2c_openadapter(I2C_CONTROLLER controller_id)
     i2c_err_detect[controller_id] = 0;
     i2c_err_source[controller_id] = 0;
 
+    i2c_open_speed[controller_id] = i2c_cfg.speed;
     ss_i2c_set_config(controller_id, &i2c_cfg);
     ss_i2c_clock_enable(controller_id);
+    i2c_bus_timing[controller_id] = i2c_cfg.speed == I2C_SLOW ? i2c_timing_slow : i2c_timing_fast;
+    i2c_loaded_timing[controller_id] = i2c_bus_timing[controller_id];
+    i2c_bus_held[controller_id] = false;
     ret = wait_dev_ready(controller_id, false);
 
     return ret;
@@ -208,53 +263,483 @@ int i2c_openadapter_speed(I2C_CONTROLLER controller_id, int i2c_speed)
     i2c_err_detect[controller_id] = 0;
     i2c_err_source[controller_id] = 0;
 
+    i2c_open_speed[controller_id] = i2c_cfg.speed;
     ss_i2c_set_config(controller_id, &i2c_cfg);
     ss_i2c_clock_enable(controller_id);
+    i2c_bus_timing[controller_id] = i2c_cfg.speed == I2C_SLOW ? i2c_timing_slow : i2c_timing_fast;
+    i2c_loaded_timing[controller_id] = i2c_bus_timing[controller_id];
+    i2c_bus_held[controller_id] = false;
     ret = wait_dev_ready(controller_id, false);
 
     return ret;
 }
 
+void i2c_closeadapter(I2C_CONTROLLER controller_id)
+{
+    uint32_t saved;
+
+    if (controller_id >= NUM_SS_I2C)
+        return;
+    saved = interrupt_lock();
+    /* Also clock gates the controller; with it stopped nothing the driver
+     * still had to report is left to land on the next user */
+    ss_i2c_deconfig(controller_id);
+    i2c_async_halt(controller_id, I2C_ERROR);
+    interrupt_unlock(saved);
+}
+
 void i2c_setslave(I2C_CONTROLLER controller_id, uint8_t addr)
 {
     i2c_slave[controller_id] = addr;
     return;
 }
 
-int i2c_writebytes(I2C_CONTROLLER controller_id, uint8_t *bytes, uint8_t length,
-                   bool no_stop)
+static int do_transfer(I2C_CONTROLLER controller_id, uint8_t *tx,
+                       uint32_t tx_len, uint8_t *rx, uint32_t rx_len,
+                       bool no_stop)
 {
     int ret;
 
     i2c_tx_complete[controller_id] = 0;
+    i2c_rx_complete[controller_id] = 0;
     i2c_err_detect[controller_id] = 0;
     i2c_err_source[controller_id] = 0;
-    ss_i2c_transfer(controller_id, bytes, length, 0, 0,
+    i2c_select_timing(controller_id, i2c_slave[controller_id], no_stop);
+    ss_i2c_transfer(controller_id, tx, tx_len, rx, rx_len,
                     i2c_slave[controller_id], no_stop);
-    ret = wait_tx_or_err(controller_id);
+    /* The driver signals a write-then-read on the read side only */
+    if (rx_len > 0 || tx_len == 0)
+        ret = wait_rx_or_err(controller_id, tx_len + rx_len);
+    else
+        ret = wait_tx_or_err(controller_id, tx_len);
     if (ret)
         return ret;
-    ret = wait_dev_ready(controller_id, no_stop);
+    return wait_dev_ready(controller_id, no_stop);
+}
+
+static struct i2c_stats *stats_for(I2C_CONTROLLER controller_id, uint8_t addr)
+{
+    struct i2c_stats *stats = i2c_stats[controller_id];
+    uint8_t i, used = i2c_stats_used[controller_id];
+
+    for (i = 0; i < used; i++) {
+        if (stats[i].addr == addr)
+            return &stats[i];
+    }
+    if (used == I2C_STATS_DEVICES)
+        return NULL;
+    i2c_stats_used[controller_id]++;
+    stats[used].addr = addr;
+    return &stats[used];
+}
+
+static void count(I2C_CONTROLLER controller_id, uint8_t addr, int ret,
+                  bool retry, bool recovered)
+{
+    struct i2c_stats *dev = stats_for(controller_id, addr);
+    struct i2c_stats *stats[2];
+    int i;
+
+    stats[0] = &i2c_stats[controller_id][I2C_STATS_DEVICES];
+    stats[1] = dev;
+    for (i = 0; i < 2 && stats[i]; i++) {
+        stats[i]->transfers++;
+        if (ret == I2C_ERROR_ADDRESS_NOACK || ret == I2C_ERROR_DATA_NOACK)
+            stats[i]->nacks++;
+        else if (ret <= I2C_TIMEOUT)
+            stats[i]->timeouts++;
+        if (retry)
+            stats[i]->retries++;
+        if (recovered)
+            stats[i]->recoveries++;
+    }
+}
+
+static int do_recover(I2C_CONTROLLER controller_id);
+
+/* Run a transfer with recovery and retries; the controller is claimed */
+static int do_transfer_retry(I2C_CONTROLLER controller_id, uint8_t *tx,
+                             uint32_t tx_len, uint8_t *rx, uint32_t rx_len,
+                             bool no_stop)
+{
+    uint8_t addr = i2c_slave[controller_id];
+    uint32_t backoff = i2c_backoff_us[controller_id];
+    uint8_t attempt;
+    bool recovered = false;
+    int ret;
+
+    if (i2c_bus_stuck[controller_id]) {
+        recovered = true;
+        ret = do_recover(controller_id);
+        if (ret) {
+            count(controller_id, addr, ret, false, recovered);
+            return ret;
+        }
+    }
+
+    for (attempt = 0;; attempt++) {
+        ret = do_transfer(controller_id, tx, tx_len, rx, rx_len, no_stop);
+        count(controller_id, addr, ret, attempt > 0, recovered);
+        recovered = false;
+        if (ret == I2C_OK || ret == I2C_ERROR_ADDRESS_NOACK ||
+            ret == I2C_ERROR_DATA_NOACK)
+            return ret;
+
+        /* Whatever is wedged is not left for the next caller to run into */
+        if (ret <= I2C_TIMEOUT) {
+            recovered = true;
+            if (do_recover(controller_id))
+                return I2C_ERROR_BUS_STUCK;
+        }
+        if (attempt >= i2c_retries[controller_id])
+            return ret;
+        delayMicroseconds(backoff);
+        backoff = (backoff * 2 > I2C_BACKOFF_MAX_US) ? I2C_BACKOFF_MAX_US : backoff * 2;
+    }
+}
+
+static int do_writebytes(I2C_CONTROLLER controller_id, uint8_t *bytes,
+                         uint8_t length, bool no_stop)
+{
+    int ret = do_transfer_retry(controller_id, bytes, length, 0, 0, no_stop);
     if (ret)
         return ret;
     return length;
 }
 
+static int do_readbytes(I2C_CONTROLLER controller_id, uint8_t *buf, int length,
+                        bool no_stop)
+{
+    int ret = do_transfer_retry(controller_id, 0, 0, buf, length, no_stop);
+    if (ret)
+        return ret;
+    return length;
+}
+
+/* The blocking calls take the controller away from the transfer queue for
+ * their duration, see i2c_async.h */
+int i2c_writebytes(I2C_CONTROLLER controller_id, uint8_t *bytes, uint8_t length,
+                   bool no_stop)
+{
+    int ret = i2c_async_claim(controller_id, TIMEOUT_MS);
+    if (ret)
+        return ret;
+    ret = do_writebytes(controller_id, bytes, length, no_stop);
+    i2c_async_release(controller_id);
+    return ret;
+}
+
 int i2c_readbytes(I2C_CONTROLLER controller_id, uint8_t *buf, int length,
                   bool no_stop)
 {
-    int ret;
+    int ret = i2c_async_claim(controller_id, TIMEOUT_MS);
+    if (ret)
+        return ret;
+    ret = do_readbytes(controller_id, buf, length, no_stop);
+    i2c_async_release(controller_id);
+    return ret;
+}
 
-    i2c_rx_complete[controller_id] = 0;
-    i2c_err_detect[controller_id] = 0;
-    i2c_err_source[controller_id] = 0;
-    ss_i2c_transfer(controller_id, 0, 0, buf, length, i2c_slave[controller_id],
-                    no_stop);
-    ret = wait_rx_or_err(controller_id);
+int i2c_transfer(I2C_CONTROLLER controller_id, uint8_t *tx, uint32_t tx_len,
+                 uint8_t *rx, uint32_t rx_len, bool no_stop)
+{
+    int ret = i2c_async_claim(controller_id, TIMEOUT_MS);
     if (ret)
         return ret;
-    ret = wait_dev_ready(controller_id, no_stop);
+    ret = do_transfer_retry(controller_id, tx, tx_len, rx, rx_len, no_stop);
+    i2c_async_release(controller_id);
+    return ret;
+}
+
+static uint32_t ns_to_cycles(uint32_t clk_hz, uint32_t ns)
+{
+    return (uint32_t)(((uint64_t)clk_hz * ns + 999999999) / 1000000000);
+}
+
+int i2c_calc_timing(uint32_t clk_hz, uint32_t scl_hz, struct i2c_timing *timing)
+{
+    uint32_t low_ns, high_ns;
+    uint32_t spk_len, total, low, high, min_low, min_high;
+
+    if (timing == NULL || scl_hz == 0 || scl_hz > I2C_MAX_SCL_HZ)
+        return I2C_ERROR;
+
+    /* Minimum SCL low and high times of the mode */
+    if (scl_hz <= 100000) {
+        low_ns = 4700;
+        high_ns = 4000;
+        timing->speed = I2C_SLOW;
+    } else if (scl_hz <= 400000) {
+        low_ns = 1300;
+        high_ns = 600;
+        timing->speed = I2C_FAST;
+    } else {
+        low_ns = 500;
+        high_ns = 260;
+        timing->speed = I2C_FAST;
+    }
+
+    /* Suppress spikes up to 50ns */
+    spk_len = ns_to_cycles(clk_hz, 50);
+    if (spk_len == 0)
+        spk_len = 1;
+
+    /* The controller stretches high by spk_len + 7 and low by 1 cycle and
+     * wants hcnt >= spk_len + 5, lcnt >= spk_len + 7 */
+    min_low = ns_to_cycles(clk_hz, low_ns);
+    if (min_low < spk_len + 8)
+        min_low = spk_len + 8;
+    min_high = ns_to_cycles(clk_hz, high_ns);
+    if (min_high < 2 * spk_len + 12)
+        min_high = 2 * spk_len + 12;
+
+    /* Round the period up so the clock is never faster than asked for */
+    total = (clk_hz + scl_hz - 1) / scl_hz;
+    if (total < min_low + min_high)
+        return I2C_ERROR;
+    low = min_low + (total - min_low - min_high) / 2;
+    high = total - low;
+
+    if (high - spk_len - 7 > 0xFFFF || low - 1 > 0xFFFF)
+        return I2C_ERROR;
+    timing->spk_len = spk_len;
+    timing->hcnt = high - spk_len - 7;
+    timing->lcnt = low - 1;
+    return I2C_OK;
+}
+
+static int timing_for(uint32_t scl_hz, struct i2c_timing *timing)
+{
+    /* Keep the driver's own counts for the standard rates */
+    if (scl_hz == 100000) {
+        *timing = i2c_timing_slow;
+        return I2C_OK;
+    }
+    if (scl_hz == 400000) {
+        *timing = i2c_timing_fast;
+        return I2C_OK;
+    }
+    return i2c_calc_timing(I2C_CLOCK_HZ, scl_hz, timing);
+}
+
+int i2c_set_clock(I2C_CONTROLLER controller_id, uint32_t scl_hz)
+{
+    struct i2c_timing timing;
+    uint32_t saved;
+
+    if (controller_id >= NUM_SS_I2C || timing_for(scl_hz, &timing))
+        return I2C_ERROR;
+    saved = interrupt_lock();
+    i2c_bus_timing[controller_id] = timing;
+    interrupt_unlock(saved);
+    return I2C_OK;
+}
+
+int i2c_set_device_clock(I2C_CONTROLLER controller_id, uint8_t addr, uint32_t scl_hz)
+{
+    struct i2c_device_clock *dev, *slot = NULL;
+    struct i2c_timing timing;
+    uint32_t saved;
+    int i;
+
+    if (controller_id >= NUM_SS_I2C)
+        return I2C_ERROR;
+    if (scl_hz && timing_for(scl_hz, &timing))
+        return I2C_ERROR;
+
+    saved = interrupt_lock();
+    for (i = 0; i < I2C_SPEED_PROFILES; i++) {
+        dev = &i2c_device_clock[controller_id][i];
+        if (dev->used && dev->addr == addr) {
+            slot = dev;
+            break;
+        }
+        if (!dev->used && slot == NULL)
+            slot = dev;
+    }
+    if (scl_hz == 0) {
+        if (slot && slot->used && slot->addr == addr)
+            slot->used = 0;
+    } else if (slot) {
+        slot->addr = addr;
+        slot->timing = timing;
+        slot->used = 1;
+    }
+    interrupt_unlock(saved);
+    return (scl_hz == 0 || slot) ? I2C_OK : I2C_ERROR;
+}
+
+/* Write the counts straight to the controller. The speed and counts only
+ * take while it is disabled, and disabling it in the middle of a transfer,
+ * or before the STOP of the last one is out, would cut the bus short; so
+ * nothing is written unless the controller is idle with its FIFO empty. */
+static int load_timing(I2C_CONTROLLER controller_id, const struct i2c_timing *timing)
+{
+    uint32_t base = I2C_REG_BASE(controller_id);
+    uint32_t saved;
+    uint32_t con;
+
+    saved = interrupt_lock();
+    if ((READ_ARC_REG(base + I2C_REG_STATUS) &
+         (I2C_STATUS_ACTIVITY | I2C_STATUS_MASTER_ACT | I2C_STATUS_TFE)) != I2C_STATUS_TFE) {
+        interrupt_unlock(saved);
+        return I2C_BUSY;
+    }
+
+    con = READ_ARC_REG(base + I2C_REG_CON);
+    WRITE_ARC_REG(con & ~I2C_CON_ENABLE, base + I2C_REG_CON);
+    con &= ~I2C_CON_TIMING_MASK;
+    con |= ((uint32_t)timing->spk_len << 22) | ((uint32_t)timing->speed << 3);
+    if (timing->speed == I2C_SLOW)
+        WRITE_ARC_REG(((uint32_t)timing->hcnt << 16) | timing->lcnt,
+                      base + I2C_REG_SS_SCL_CNT);
+    else
+        WRITE_ARC_REG(((uint32_t)timing->hcnt << 16) | timing->lcnt,
+                      base + I2C_REG_FS_SCL_CNT);
+    /* Back with the enable bit as it was */
+    WRITE_ARC_REG(con, base + I2C_REG_CON);
+    interrupt_unlock(saved);
+    return I2C_OK;
+}
+
+void i2c_select_timing(I2C_CONTROLLER controller_id, uint8_t addr, bool no_stop)
+{
+    const struct i2c_timing *want = &i2c_bus_timing[controller_id];
+    struct i2c_timing *loaded = &i2c_loaded_timing[controller_id];
+    int i;
+
+    if (!i2c_bus_held[controller_id]) {
+        for (i = 0; i < I2C_SPEED_PROFILES; i++) {
+            const struct i2c_device_clock *dev = &i2c_device_clock[controller_id][i];
+            if (dev->used && dev->addr == addr) {
+                want = &dev->timing;
+                break;
+            }
+        }
+        if (want->speed != loaded->speed || want->spk_len != loaded->spk_len ||
+            want->hcnt != loaded->hcnt || want->lcnt != loaded->lcnt) {
+            if (load_timing(controller_id, want) == I2C_OK)
+                *loaded = *want;
+        }
+    }
+    i2c_bus_held[controller_id] = no_stop;
+}
+
+/* I2C_SENSING_0 shares its lines with header pins SDA and SCL, which can be
+ * driven as GPIOs while the controller is off */
+static void header_line(uint8_t pin, bool high)
+{
+    if (high) {
+        pinMode(pin, INPUT);
+    } else {
+        digitalWrite(pin, LOW);
+        pinMode(pin, OUTPUT);
+    }
+}
+
+static void header_scl(void *ctx, bool high)
+{
+    header_line(PIN_WIRE_SCL, high);
+}
+
+static void header_sda(void *ctx, bool high)
+{
+    header_line(PIN_WIRE_SDA, high);
+}
+
+static bool header_get_scl(void *ctx)
+{
+    return digitalRead(PIN_WIRE_SCL) == HIGH;
+}
+
+static bool header_get_sda(void *ctx)
+{
+    return digitalRead(PIN_WIRE_SDA) == HIGH;
+}
+
+static void line_delay(uint32_t us)
+{
+    delayMicroseconds(us);
+}
+
+static const struct i2c_bus_lines i2c_sensing_0_lines = {
+    header_scl, header_sda, header_get_scl, header_get_sda, line_delay, NULL,
+    5 /* 100kHz */
+};
+
+/* The controller is claimed */
+static int do_recover(I2C_CONTROLLER controller_id)
+{
+    struct i2c_timing bus;
+    int ret = I2C_OK;
+    int open_ret;
+
+    /* The controller lets go of the lines while it is disabled */
+    ss_i2c_clock_disable(controller_id);
+    if (controller_id == I2C_SENSING_0)
+        ret = i2c_bus_clear(&i2c_sensing_0_lines);
+
+    bus = i2c_bus_timing[controller_id];
+    open_ret = i2c_openadapter_speed(controller_id, i2c_open_speed[controller_id]);
+    i2c_bus_timing[controller_id] = bus;
+    if (ret == I2C_OK && open_ret != I2C_OK)
+        ret = I2C_ERROR_BUS_STUCK;
+
+    i2c_bus_stuck[controller_id] = (ret != I2C_OK);
+    return ret;
+}
+
+int i2c_reset_controller(I2C_CONTROLLER controller_id)
+{
+    return do_recover(controller_id);
+}
+
+int i2c_recover(I2C_CONTROLLER controller_id)
+{
+    int ret;
+
+    if (controller_id >= NUM_SS_I2C)
+        return I2C_ERROR;
+    ret = i2c_async_claim(controller_id, TIMEOUT_MS);
     if (ret)
         return ret;
-    return length;
+    ret = do_recover(controller_id);
+    i2c_async_release(controller_id);
+    return ret;
+}
+
+void i2c_set_retry(I2C_CONTROLLER controller_id, uint8_t retries, uint32_t backoff_us)
+{
+    if (controller_id >= NUM_SS_I2C)
+        return;
+    i2c_retries[controller_id] = retries;
+    i2c_backoff_us[controller_id] = backoff_us;
+}
+
+int i2c_get_stats(I2C_CONTROLLER controller_id, uint8_t addr, struct i2c_stats *stats)
+{
+    uint8_t i;
+
+    if (controller_id >= NUM_SS_I2C || stats == NULL)
+        return I2C_ERROR;
+    if (addr == I2C_STATS_BUS) {
+        *stats = i2c_stats[controller_id][I2C_STATS_DEVICES];
+        stats->addr = I2C_STATS_BUS;
+        return I2C_OK;
+    }
+    for (i = 0; i < i2c_stats_used[controller_id]; i++) {
+        if (i2c_stats[controller_id][i].addr == addr) {
+            *stats = i2c_stats[controller_id][i];
+            return I2C_OK;
+        }
+    }
+    return I2C_ERROR;
+}
+
+void i2c_reset_stats(I2C_CONTROLLER controller_id)
+{
+    if (controller_id >= NUM_SS_I2C)
+        return;
+    memset(i2c_stats[controller_id], 0, sizeof(i2c_stats[controller_id]));
+    i2c_stats_used[controller_id] = 0;
 }
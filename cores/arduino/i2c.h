@@ -36,15 +36,97 @@ extern "C"{
 #define I2C_ERROR_ADDRESS_NOACK (-2)
 #define I2C_ERROR_DATA_NOACK    (-3)
 #define I2C_ERROR_OTHER         (-4)
+#define I2C_ERROR_BUS_STUCK     (-5)    /* recovery could not free the bus */
 
 #define I2C_ABRT_7B_ADDR_NOACK  (1 << 0)
 #define I2C_ABRT_TXDATA_NOACK   (1 << 3)
 
+/* Clock the sensing subsystem I2C controllers count SCL periods in */
+#ifndef I2C_CLOCK_HZ
+#define I2C_CLOCK_HZ            32000000
+#endif
+/* Fastest SCL the controllers can do: Fast-mode Plus */
+#define I2C_MAX_SCL_HZ          1000000
+/* Devices that can have their own clock, per controller */
+#ifndef I2C_SPEED_PROFILES
+#define I2C_SPEED_PROFILES      8
+#endif
+
+/* Retries of a transfer that timed out, each after recovering the bus and
+ * waiting twice as long as before, from I2C_BACKOFF_US up to
+ * I2C_BACKOFF_MAX_US */
+#ifndef I2C_RETRIES
+#define I2C_RETRIES             2
+#endif
+#define I2C_BACKOFF_US          100
+#define I2C_BACKOFF_MAX_US      10000
+/* Devices counted separately in the statistics, per controller */
+#ifndef I2C_STATS_DEVICES
+#define I2C_STATS_DEVICES       8
+#endif
+/* Address to ask i2c_get_stats() for the totals of the whole bus */
+#define I2C_STATS_BUS           0xFF
+
+struct i2c_stats {
+    uint8_t addr;
+    uint32_t transfers;
+    uint32_t nacks;         /* address or data not acknowledged */
+    uint32_t timeouts;
+    uint32_t retries;
+    uint32_t recoveries;    /* bus recoveries a transfer had to go through */
+};
+
+/* SCL timing in controller clock cycles: SCL is high for hcnt + spk_len + 7
+ * and low for lcnt + 1 cycles */
+struct i2c_timing {
+    uint8_t speed;          /* I2C_SLOW or I2C_FAST */
+    uint8_t spk_len;
+    uint16_t hcnt;
+    uint16_t lcnt;
+};
+
 int i2c_openadapter(I2C_CONTROLLER controller_id);
 int i2c_openadapter_speed(I2C_CONTROLLER controller_id, int i2c_speed);
+void i2c_closeadapter(I2C_CONTROLLER controller_id);
 void i2c_setslave(I2C_CONTROLLER controller_id, uint8_t addr);
 int i2c_writebytes(I2C_CONTROLLER controller_id, uint8_t *bytes, uint8_t length, bool no_stop);
 int i2c_readbytes(I2C_CONTROLLER controller_id, uint8_t *buf, int length, bool no_stop);
+/* Write 'tx' then read into 'rx' with a repeated start, as one bus
+ * transaction to the address set with i2c_setslave(); returns I2C_OK */
+int i2c_transfer(I2C_CONTROLLER controller_id, uint8_t *tx, uint32_t tx_len,
+                 uint8_t *rx, uint32_t rx_len, bool no_stop);
+
+/* Work out the counts for 'scl_hz' (up to I2C_MAX_SCL_HZ) from a 'clk_hz'
+ * controller clock, meeting the I2C low/high minimums of the mode the rate
+ * falls in. The rate is nominal: the bus rise time makes it a bit slower. */
+int i2c_calc_timing(uint32_t clk_hz, uint32_t scl_hz, struct i2c_timing *timing);
+/* Set the bus clock, or with i2c_set_device_clock() the clock for one
+ * address (0 Hz drops it). Nothing is reopened; the timing is switched
+ * between transactions when the next one needs a different clock. Opening
+ * the adapter resets the bus clock but keeps device clocks. */
+int i2c_set_clock(I2C_CONTROLLER controller_id, uint32_t scl_hz);
+int i2c_set_device_clock(I2C_CONTROLLER controller_id, uint8_t addr, uint32_t scl_hz);
+/* Load the timing 'addr' needs before a transaction. Not while a previous
+ * transaction left the bus held with no_stop, nor while the controller is
+ * still busy, say sending the STOP of the last one: the transaction then
+ * runs at the clock already loaded and the next one tries again. Interrupts
+ * must be locked or the controller claimed. */
+void i2c_select_timing(I2C_CONTROLLER controller_id, uint8_t addr, bool no_stop);
+
+/*
+ * A blocking transfer that times out leaves the controller in reset while
+ * the bus is cleared: SCL is clocked through the header pins (I2C_SENSING_0
+ * only, the other controller has no pins to do it through), a STOP is sent
+ * and the adapter is reopened with its clock settings. The transfer is then
+ * retried as set with i2c_set_retry(); NACKs are reported, not retried. If
+ * the bus stays stuck, calls fail with I2C_ERROR_BUS_STUCK straight away
+ * until a recovery works, instead of running into the timeout every time.
+ * i2c_recover() does the same on demand, between queued transfers.
+ */
+int i2c_recover(I2C_CONTROLLER controller_id);
+void i2c_set_retry(I2C_CONTROLLER controller_id, uint8_t retries, uint32_t backoff_us);
+int i2c_get_stats(I2C_CONTROLLER controller_id, uint8_t addr, struct i2c_stats *stats);
+void i2c_reset_stats(I2C_CONTROLLER controller_id);
 
 #ifdef __cplusplus
 }
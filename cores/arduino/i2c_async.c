@@ -0,0 +1,314 @@
+/*
+ * i2c_async.c - queued, interrupt driven transfers on the sensing
+ *               subsystem I2C controllers
+ *
+ * Copyright (C) 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Each controller owns a singly linked queue of caller-provided
+ * descriptors. The head is the transfer on the wire; when the driver
+ * reports it finished, from its interrupt handler, the head is completed
+ * and the next one started right there, so the bus never waits on loop().
+ * The head stays running until the driver reports it, even when cancelled,
+ * so the controller is never handed a transfer while busy and a late
+ * report never completes the wrong descriptor. Only i2c_async_abort() and
+ * i2c_async_halt() let go of it earlier, once the controller is stopped.
+ * Only ss_i2c_transfer()/ss_i2c_status(), i2c_select_timing(),
+ * i2c_reset_controller() and interrupt_lock() are used, which keeps the
+ * file buildable against a simulated controller.
+ */
+
+#include "i2c.h"
+#include "i2c_async.h"
+#include "interrupt.h"
+#include "wiring.h"
+
+static i2c_xfer_t *queue_head[NUM_SS_I2C];
+static i2c_xfer_t *queue_tail[NUM_SS_I2C];
+static volatile bool running[NUM_SS_I2C];
+static volatile bool claimed[NUM_SS_I2C];
+/* The running head was cancelled, report it with cancel_status[] */
+static volatile bool cancelled[NUM_SS_I2C];
+static int cancel_status[NUM_SS_I2C];
+
+/* The driver treats an empty transfer as a bus scan and reads one byte */
+static uint8_t scan_byte;
+
+int i2c_abort_error(uint32_t abort_source)
+{
+    if (abort_source & I2C_ABRT_7B_ADDR_NOACK)
+        return I2C_ERROR_ADDRESS_NOACK; // NACK on transmit of address
+    if (abort_source & I2C_ABRT_TXDATA_NOACK)
+        return I2C_ERROR_DATA_NOACK; // NACK on transmit of data
+    return I2C_ERROR_OTHER;
+}
+
+/* Pop the head and report it; interrupts must be locked */
+static void finish_head(uint8_t id, int status)
+{
+    i2c_xfer_t *xfer = queue_head[id];
+
+    queue_head[id] = xfer->next;
+    if (queue_head[id] == NULL)
+        queue_tail[id] = NULL;
+    running[id] = false;
+    cancelled[id] = false;
+
+    xfer->next = NULL;
+    xfer->status = status;
+    if (xfer->done)
+        xfer->done(xfer);
+}
+
+/* Put the head on the wire unless something already is; interrupts must
+ * be locked */
+static void start_next(uint8_t id)
+{
+    while (queue_head[id] && !running[id] && !claimed[id]) {
+        i2c_xfer_t *xfer = queue_head[id];
+        uint8_t *rx = xfer->rx;
+
+        if (xfer->rx_len == 0 && xfer->tx_len == 0)
+            rx = &scan_byte;
+        running[id] = true;
+        i2c_select_timing((I2C_CONTROLLER)id, xfer->addr, xfer->no_stop);
+        if (ss_i2c_transfer((I2C_CONTROLLER)id, (uint8_t *)xfer->tx,
+                            xfer->tx_len, rx, xfer->rx_len, xfer->addr,
+                            xfer->no_stop) == DRV_RC_OK)
+            return;
+        finish_head(id, I2C_ERROR);
+    }
+}
+
+int i2c_async_submit(I2C_CONTROLLER controller_id, i2c_xfer_t *xfer)
+{
+    uint32_t saved;
+    i2c_xfer_t *cur;
+
+    if (controller_id >= NUM_SS_I2C || xfer == NULL)
+        return I2C_ERROR;
+
+    saved = interrupt_lock();
+    for (cur = queue_head[controller_id]; cur; cur = cur->next) {
+        if (cur == xfer) {
+            interrupt_unlock(saved);
+            return I2C_ERROR;
+        }
+    }
+    xfer->controller = controller_id;
+    xfer->status = I2C_PENDING;
+    xfer->next = NULL;
+    if (queue_tail[controller_id])
+        queue_tail[controller_id]->next = xfer;
+    else
+        queue_head[controller_id] = xfer;
+    queue_tail[controller_id] = xfer;
+    start_next(controller_id);
+    interrupt_unlock(saved);
+    return I2C_OK;
+}
+
+void i2c_async_cancel(i2c_xfer_t *xfer, int status)
+{
+    uint8_t id = xfer->controller;
+    uint32_t saved = interrupt_lock();
+    i2c_xfer_t *prev = NULL;
+    i2c_xfer_t *cur;
+
+    if (id >= NUM_SS_I2C || xfer->status != I2C_PENDING) {
+        interrupt_unlock(saved);
+        return;
+    }
+
+    for (cur = queue_head[id]; cur && cur != xfer; cur = cur->next)
+        prev = cur;
+    if (cur == NULL) {
+        interrupt_unlock(saved);
+        return;
+    }
+
+    if (prev == NULL) {
+        if (running[id]) {
+            /* On the wire: it completes when the driver reports it */
+            cancelled[id] = true;
+            cancel_status[id] = status;
+            interrupt_unlock(saved);
+            return;
+        }
+        finish_head(id, status);
+    } else {
+        prev->next = xfer->next;
+        if (queue_tail[id] == xfer)
+            queue_tail[id] = prev;
+        xfer->next = NULL;
+        xfer->status = status;
+        if (xfer->done)
+            xfer->done(xfer);
+    }
+    start_next(id);
+    interrupt_unlock(saved);
+}
+
+void i2c_async_abort(i2c_xfer_t *xfer, int status)
+{
+    uint8_t id = xfer->controller;
+    uint32_t saved;
+
+    if (id >= NUM_SS_I2C)
+        return;
+
+    saved = interrupt_lock();
+    if (xfer->status != I2C_PENDING || queue_head[id] != xfer || !running[id]) {
+        interrupt_unlock(saved);
+        i2c_async_cancel(xfer, status);
+        return;
+    }
+    /* Hold the queue and stop listening to the driver, whatever it still
+     * reports belongs to the transfer being dropped */
+    running[id] = false;
+    claimed[id] = true;
+    interrupt_unlock(saved);
+
+    /* Afterwards the controller no longer touches the caller's buffers */
+    i2c_reset_controller((I2C_CONTROLLER)id);
+
+    saved = interrupt_lock();
+    if (queue_head[id] == xfer)
+        finish_head(id, status);
+    claimed[id] = false;
+    start_next(id);
+    interrupt_unlock(saved);
+}
+
+int i2c_async_wait(i2c_xfer_t *xfer, uint32_t timeout_ms)
+{
+    uint64_t start = millis();
+
+    while (xfer->status == I2C_PENDING) {
+        if (millis() - start >= timeout_ms) {
+            i2c_async_abort(xfer, I2C_TIMEOUT);
+            break;
+        }
+    }
+    return xfer->status;
+}
+
+void i2c_async_cancel_all(I2C_CONTROLLER controller_id, int status)
+{
+    uint32_t saved = interrupt_lock();
+    i2c_xfer_t *rest = queue_head[controller_id];
+    i2c_xfer_t *xfer;
+
+    if (rest && running[controller_id]) {
+        /* The running head completes when the driver reports it */
+        cancelled[controller_id] = true;
+        cancel_status[controller_id] = status;
+        queue_tail[controller_id] = rest;
+        xfer = rest;
+        rest = rest->next;
+        xfer->next = NULL;
+    } else {
+        queue_head[controller_id] = NULL;
+        queue_tail[controller_id] = NULL;
+    }
+
+    /* Anything the callbacks submit is queued as usual */
+    while (rest) {
+        xfer = rest;
+        rest = rest->next;
+        xfer->next = NULL;
+        xfer->status = status;
+        if (xfer->done)
+            xfer->done(xfer);
+    }
+    interrupt_unlock(saved);
+}
+
+void i2c_async_halt(I2C_CONTROLLER controller_id, int status)
+{
+    uint32_t saved = interrupt_lock();
+
+    running[controller_id] = false;
+    claimed[controller_id] = true;
+    while (queue_head[controller_id])
+        finish_head(controller_id, status);
+    claimed[controller_id] = false;
+    interrupt_unlock(saved);
+}
+
+bool i2c_async_busy(I2C_CONTROLLER controller_id)
+{
+    return controller_id < NUM_SS_I2C && queue_head[controller_id] != NULL;
+}
+
+int i2c_async_claim(I2C_CONTROLLER controller_id, uint32_t timeout_ms)
+{
+    uint64_t start = millis();
+
+    claimed[controller_id] = true;
+    while (running[controller_id]) {
+        if (millis() - start >= timeout_ms) {
+            claimed[controller_id] = false;
+            return I2C_TIMEOUT;
+        }
+    }
+    return I2C_OK;
+}
+
+void i2c_async_release(I2C_CONTROLLER controller_id)
+{
+    uint32_t saved = interrupt_lock();
+
+    claimed[controller_id] = false;
+    start_next(controller_id);
+    interrupt_unlock(saved);
+}
+
+void i2c_async_done(I2C_CONTROLLER controller_id)
+{
+    uint32_t saved;
+
+    if (!running[controller_id])
+        return;
+
+    saved = interrupt_lock();
+    /* On an abort the driver reports the STOP before the error; leave the
+     * transfer for i2c_async_error() in that case */
+    if (ss_i2c_status(controller_id, queue_head[controller_id]->no_stop) !=
+        I2C_TX_ABORT) {
+        finish_head(controller_id, cancelled[controller_id] ?
+                    cancel_status[controller_id] : I2C_OK);
+        start_next(controller_id);
+    }
+    interrupt_unlock(saved);
+}
+
+void i2c_async_error(I2C_CONTROLLER controller_id, uint32_t abort_source)
+{
+    uint32_t saved;
+
+    if (!running[controller_id])
+        return;
+
+    saved = interrupt_lock();
+    finish_head(controller_id, cancelled[controller_id] ?
+                cancel_status[controller_id] : i2c_abort_error(abort_source));
+    start_next(controller_id);
+    interrupt_unlock(saved);
+}
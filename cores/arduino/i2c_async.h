@@ -0,0 +1,115 @@
+/*
+ * i2c_async.h - queued, interrupt driven transfers on the sensing
+ *               subsystem I2C controllers
+ *
+ * Copyright (C) 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef i2c_async_h
+#define i2c_async_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include "ss_i2c_iface.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Status of a transfer that has not completed yet; finished transfers
+ * hold I2C_OK or one of the negative I2C_* error codes from i2c.h */
+#define I2C_PENDING  1
+
+typedef struct i2c_xfer i2c_xfer_t;
+
+/* Called from interrupt context, or with interrupts disabled, once the
+ * transfer finished. It may submit further transfers, including itself. */
+typedef void (*i2c_xfer_cb)(i2c_xfer_t *xfer);
+
+/*
+ * One bus transaction: an optional write followed by an optional read with
+ * a repeated start. The descriptor and both buffers belong to the caller
+ * and must stay valid until the transfer completes; nothing is copied.
+ */
+struct i2c_xfer {
+    uint8_t addr;
+    const uint8_t *tx;
+    uint32_t tx_len;
+    uint8_t *rx;
+    uint32_t rx_len;
+    bool no_stop;           /* keep the bus for the next queued transfer */
+    i2c_xfer_cb done;
+    void *arg;              /* free for the caller */
+    volatile int status;
+
+    /* private */
+    i2c_xfer_t *next;
+    uint8_t controller;
+};
+
+/* Queue a transfer on an adapter opened with i2c_openadapter*(). Returns
+ * I2C_OK once queued, or I2C_ERROR if the descriptor is already queued or
+ * the controller is invalid. */
+int i2c_async_submit(I2C_CONTROLLER controller_id, i2c_xfer_t *xfer);
+
+/* Block until 'xfer' completes and return its status. After 'timeout_ms'
+ * the transfer is aborted as with i2c_async_abort() and I2C_TIMEOUT is
+ * returned. Not from interrupt context. */
+int i2c_async_wait(i2c_xfer_t *xfer, uint32_t timeout_ms);
+
+/* Complete a transfer with 'status' instead of its own result. A queued
+ * one is removed straight away. One already on the wire keeps running
+ * and is completed when the driver reports it, so its buffers stay in
+ * use until then; the queue goes on after it as usual. */
+void i2c_async_cancel(i2c_xfer_t *xfer, int status);
+
+/* As i2c_async_cancel(), but a transfer on the wire is stopped: the
+ * controller is reset and the bus cleared as by i2c_recover(), then the
+ * transfer completes with 'status' and the queue goes on. On return the
+ * buffers are free. Not from interrupt context. */
+void i2c_async_abort(i2c_xfer_t *xfer, int status);
+
+/* i2c_async_cancel() every queued or running transfer */
+void i2c_async_cancel_all(I2C_CONTROLLER controller_id, int status);
+
+/* true while transfers are queued or running */
+bool i2c_async_busy(I2C_CONTROLLER controller_id);
+
+/*
+ * Glue for i2c.c. The blocking API claims the controller, which waits for
+ * the running transfer and holds back the queue until it is released.
+ * The ss_i2c driver callbacks report to i2c_async_done()/i2c_async_error().
+ */
+int i2c_async_claim(I2C_CONTROLLER controller_id, uint32_t timeout_ms);
+void i2c_async_release(I2C_CONTROLLER controller_id);
+void i2c_async_done(I2C_CONTROLLER controller_id);
+void i2c_async_error(I2C_CONTROLLER controller_id, uint32_t abort_source);
+/* The controller was stopped: complete everything with 'status' without
+ * waiting for the driver, nothing is started. */
+void i2c_async_halt(I2C_CONTROLLER controller_id, int status);
+/* Provided by i2c.c: stop the controller and bring it back with the bus
+ * cleared, as i2c_recover() does; the controller is claimed. */
+int i2c_reset_controller(I2C_CONTROLLER controller_id);
+
+/* Map a TX_ABRT_SOURCE value to an I2C_ERROR_* code */
+int i2c_abort_error(uint32_t abort_source);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* i2c_async_h */
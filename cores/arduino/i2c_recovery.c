@@ -0,0 +1,80 @@
+/*
+ * i2c_recovery.c - freeing an I2C bus held by a confused slave
+ *
+ * Copyright (C) 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * A slave reset or interrupted in the middle of a read keeps driving the
+ * data bit it was on, and the controller cannot start anything while SDA
+ * is low. Clocking SCL by hand walks the slave through to the end of its
+ * byte, it then sees no ACK and lets go; a STOP puts it back to idle.
+ * Everything goes through struct i2c_bus_lines so this runs just as well
+ * against a simulated bus.
+ */
+
+#include "i2c.h"
+#include "i2c_recovery.h"
+
+/* Release SCL and wait out clock stretching */
+static bool scl_release(const struct i2c_bus_lines *lines)
+{
+    uint32_t waited = 0;
+
+    lines->set_scl(lines->ctx, true);
+    lines->delay_us(lines->half_period_us);
+    while (!lines->get_scl(lines->ctx)) {
+        if (waited >= I2C_RECOVERY_STRETCH_US)
+            return false;
+        lines->delay_us(lines->half_period_us);
+        waited += lines->half_period_us;
+    }
+    return true;
+}
+
+int i2c_bus_clear(const struct i2c_bus_lines *lines)
+{
+    int pulses;
+
+    lines->set_sda(lines->ctx, true);
+    if (!scl_release(lines))
+        return I2C_ERROR_BUS_STUCK;
+
+    for (pulses = 0; pulses < I2C_RECOVERY_PULSES; pulses++) {
+        if (lines->get_sda(lines->ctx))
+            break;
+        lines->set_scl(lines->ctx, false);
+        lines->delay_us(lines->half_period_us);
+        if (!scl_release(lines))
+            return I2C_ERROR_BUS_STUCK;
+    }
+
+    /* STOP: SDA rises while SCL is high */
+    lines->set_scl(lines->ctx, false);
+    lines->delay_us(lines->half_period_us);
+    lines->set_sda(lines->ctx, false);
+    lines->delay_us(lines->half_period_us);
+    if (!scl_release(lines))
+        return I2C_ERROR_BUS_STUCK;
+    lines->set_sda(lines->ctx, true);
+    lines->delay_us(lines->half_period_us);
+
+    if (!lines->get_sda(lines->ctx) || !lines->get_scl(lines->ctx))
+        return I2C_ERROR_BUS_STUCK;
+    return I2C_OK;
+}
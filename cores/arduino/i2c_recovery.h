@@ -0,0 +1,64 @@
+/*
+ * i2c_recovery.h - freeing an I2C bus held by a confused slave
+ *
+ * Copyright (C) 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef i2c_recovery_h
+#define i2c_recovery_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Clock pulses that get any slave through the rest of a byte and its ACK */
+#define I2C_RECOVERY_PULSES     9
+/* How long a slave may stretch SCL during recovery */
+#ifndef I2C_RECOVERY_STRETCH_US
+#define I2C_RECOVERY_STRETCH_US 1000
+#endif
+
+/*
+ * The two lines of a bus, bit-banged open drain while its controller is
+ * off: set_*() releases the line when 'high' is true and pulls it low
+ * otherwise, get_*() reads the level actually on the wire.
+ */
+struct i2c_bus_lines {
+    void (*set_scl)(void *ctx, bool high);
+    void (*set_sda)(void *ctx, bool high);
+    bool (*get_scl)(void *ctx);
+    bool (*get_sda)(void *ctx);
+    void (*delay_us)(uint32_t us);
+    void *ctx;
+    uint32_t half_period_us;
+};
+
+/*
+ * Clock up to I2C_RECOVERY_PULSES pulses until a slave holding SDA low lets
+ * go, then send a STOP. Returns I2C_OK with both lines high afterwards, or
+ * I2C_ERROR_BUS_STUCK if SCL is held low or SDA never comes free.
+ */
+int i2c_bus_clear(const struct i2c_bus_lines *lines);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* i2c_recovery_h */
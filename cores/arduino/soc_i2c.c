@@ -20,7 +20,10 @@
  */
 
 #include <stdbool.h>
+#include <string.h>
 #include "intel_qrk_i2c.h"
+#include "soc_i2c_priv.h"
+#include "portable.h"
 #include "variant.h"
 #include "soc_i2c.h"
 #include "i2c.h"
@@ -66,6 +69,192 @@ static void soc_i2c1_err_callback(uint32_t dev_id)
     soc_i2c_err_source[SOC_I2C_1] = dev_id;
 }
 
+#define SLAVE_MODE_USER     0
+#define SLAVE_MODE_REGMAP   1
+#define SLAVE_MODE_STREAM   2
+
+/* Handed to the engine with a full stage, more of the same write follows */
+#define SLAVE_RX_MORE       0x80000000
+
+/* The driver's interrupt handlers, see soc_i2c_slave_isr() */
+extern void isr_dev_0(void);
+extern void isr_dev_1(void);
+
+static struct soc_i2c_slave {
+    volatile uint8_t mode;
+    uint8_t *stage;
+    uint32_t stage_size;
+    uint32_t staged;
+    bool rx_open;           /* a write has started and not been finished */
+    uint32_t tx_sent;       /* bytes handed out in the current read */
+    void *arg;
+
+    /* register map */
+    uint8_t *map;
+    uint32_t map_size;
+    uint8_t addr_bytes;
+    uint8_t addr_left;      /* address bytes still expected in this write */
+    uint32_t addr_acc;
+    volatile uint32_t reg;
+    uint32_t write_start;
+    uint32_t written;
+    void (*on_write)(uint32_t, uint32_t, void *);
+
+    /* stream */
+    uint8_t *ring;
+    uint32_t ring_mask;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped;
+    const uint8_t *(*on_request)(uint32_t, uint32_t *, void *);
+} soc_i2c_slave[NUM_SOC_I2C];
+
+/* Sent when a stream read has nothing to offer */
+static uint8_t soc_i2c_slave_idle_byte = 0xFF;
+
+static void soc_i2c_slave_regmap_rx(struct soc_i2c_slave *s, uint32_t bytes)
+{
+    uint32_t n = bytes & ~SLAVE_RX_MORE;
+    const uint8_t *p = s->stage;
+
+    while (n && s->addr_left) {
+        s->addr_acc = (s->addr_acc << 8) | *p++;
+        n--;
+        if (--s->addr_left == 0) {
+            s->reg = s->addr_acc % s->map_size;
+            s->write_start = s->reg;
+        }
+    }
+    while (n) {
+        uint32_t run = s->map_size - s->reg;
+        if (run > n)
+            run = n;
+        memcpy(s->map + s->reg, p, run);
+        p += run;
+        n -= run;
+        s->written += run;
+        s->reg = (s->reg + run == s->map_size) ? 0 : s->reg + run;
+    }
+
+    if (!(bytes & SLAVE_RX_MORE)) {
+        if (s->written && s->on_write)
+            s->on_write(s->write_start, s->written, s->arg);
+        s->written = 0;
+        s->addr_left = s->addr_bytes;
+        s->addr_acc = 0;
+    }
+}
+
+static void soc_i2c_slave_stream_rx(struct soc_i2c_slave *s, uint32_t bytes)
+{
+    uint32_t n = bytes & ~SLAVE_RX_MORE;
+    uint32_t head = s->head;
+    uint32_t room = s->ring_mask + 1 - (head - s->tail);
+    const uint8_t *p = s->stage;
+
+    if (n > room) {
+        s->dropped += n - room;
+        n = room;
+    }
+    while (n) {
+        uint32_t idx = head & s->ring_mask;
+        uint32_t run = s->ring_mask + 1 - idx;
+        if (run > n)
+            run = n;
+        memcpy(s->ring + idx, p, run);
+        p += run;
+        n -= run;
+        head += run;
+    }
+    s->head = head;
+}
+
+static void soc_i2c_slave_deliver(struct soc_i2c_slave *s, uint32_t bytes)
+{
+    if (s->mode == SLAVE_MODE_REGMAP)
+        soc_i2c_slave_regmap_rx(s, bytes);
+    else
+        soc_i2c_slave_stream_rx(s, bytes);
+    s->staged = 0;
+    s->rx_open = (bytes & SLAVE_RX_MORE) != 0;
+}
+
+/* Empty the receive FIFO into the stage, passing on every full stage */
+static void soc_i2c_slave_drain(struct soc_i2c_slave *s, uint32_t base)
+{
+    uint32_t avail = MMIO_REG_VAL_FROM_BASE(base, IC_RXFLR);
+
+    if (avail)
+        s->rx_open = true;
+    while (avail--) {
+        s->stage[s->staged++] = MMIO_REG_VAL_FROM_BASE(base, IC_DATA_CMD);
+        if (s->staged == s->stage_size)
+            soc_i2c_slave_deliver(s, s->staged | SLAVE_RX_MORE);
+    }
+}
+
+/*
+ * The driver only reads as much as its receive buffer holds and reports
+ * it at the STOP, so a longer write fills the FIFO and stalls, and the
+ * write half of a write-then-read is only seen after the read. With the
+ * engine on, the receive side is done here instead: the FIFO is drained
+ * before the driver looks at it, and each write is passed on before the
+ * read that follows it is served. The driver keeps serving reads.
+ */
+static void soc_i2c_slave_isr(SOC_I2C_CONTROLLER controller_id, uint32_t base,
+                              void (*driver_isr)(void))
+{
+    struct soc_i2c_slave *s = &soc_i2c_slave[controller_id];
+    uint32_t stat;
+
+    if (s->mode == SLAVE_MODE_USER) {
+        driver_isr();
+        return;
+    }
+
+    stat = MMIO_REG_VAL_FROM_BASE(base, IC_INTR_STAT);
+    if (stat & (IC_INTR_RX_FULL | IC_INTR_RD_REQ | IC_INTR_STOP_DET))
+        soc_i2c_slave_drain(s, base);
+    if ((stat & (IC_INTR_RD_REQ | IC_INTR_STOP_DET)) && s->rx_open)
+        soc_i2c_slave_deliver(s, s->staged);
+    if (stat & (IC_INTR_RX_FULL | IC_INTR_RX_DONE | IC_INTR_STOP_DET))
+        s->tx_sent = 0;
+    driver_isr();
+}
+
+DECLARE_INTERRUPT_HANDLER static void soc_i2c0_slave_isr()
+{
+    soc_i2c_slave_isr(SOC_I2C_0, SOC_I2C_0_BASE, isr_dev_0);
+}
+
+DECLARE_INTERRUPT_HANDLER static void soc_i2c1_slave_isr()
+{
+    soc_i2c_slave_isr(SOC_I2C_1, SOC_I2C_1_BASE, isr_dev_1);
+}
+
+static void soc_i2c_slave_tx(SOC_I2C_CONTROLLER controller_id)
+{
+    struct soc_i2c_slave *s = &soc_i2c_slave[controller_id];
+    uint32_t sent = s->tx_sent;
+    uint32_t len = 0;
+
+    if (s->mode == SLAVE_MODE_REGMAP) {
+        /* Each chunk runs to the end of the map, so asking for more means
+         * the master reads on past it: wrap around */
+        uint32_t start = sent ? 0 : s->reg;
+        len = s->map_size - start;
+        soc_i2c_slave_enable_tx(controller_id, s->map + start, len);
+    } else {
+        const uint8_t *data = s->on_request ? s->on_request(sent, &len, s->arg) : NULL;
+        if (data == NULL || len == 0) {
+            data = &soc_i2c_slave_idle_byte;
+            len = 1;
+        }
+        soc_i2c_slave_enable_tx(controller_id, (uint8_t *)data, len);
+    }
+    s->tx_sent = sent + len;
+}
+
 static void (*soc_i2c0_slave_rx_user_callback)(int, void *) = NULL;
 static void *soc_i2c0_slave_rx_user_cb_data_ptr = NULL;
 
@@ -80,6 +269,9 @@ static void *soc_i2c1_slave_tx_user_cb_data_ptr = NULL;
 
 static void soc_i2c0_slave_rx_callback(uint32_t bytes)
 {
+    /* The engine takes its data from the FIFO itself */
+    if (soc_i2c_slave[SOC_I2C_0].mode != SLAVE_MODE_USER)
+        return;
     if (soc_i2c0_slave_rx_user_callback) {
       soc_i2c0_slave_rx_user_callback((int)bytes, soc_i2c0_slave_rx_user_cb_data_ptr);
     }
@@ -87,6 +279,9 @@ static void soc_i2c0_slave_rx_callback(uint32_t bytes)
 
 static void soc_i2c1_slave_rx_callback(uint32_t bytes)
 {
+    /* The engine takes its data from the FIFO itself */
+    if (soc_i2c_slave[SOC_I2C_1].mode != SLAVE_MODE_USER)
+        return;
     if (soc_i2c1_slave_rx_user_callback) {
       soc_i2c1_slave_rx_user_callback((int)bytes, soc_i2c1_slave_rx_user_cb_data_ptr);
     }
@@ -94,14 +289,18 @@ static void soc_i2c1_slave_rx_callback(uint32_t bytes)
 
 static void soc_i2c0_slave_tx_callback(uint32_t bytes)
 {
-    if (soc_i2c0_slave_tx_user_callback) {
+    if (soc_i2c_slave[SOC_I2C_0].mode != SLAVE_MODE_USER) {
+        soc_i2c_slave_tx(SOC_I2C_0);
+    } else if (soc_i2c0_slave_tx_user_callback) {
         soc_i2c0_slave_tx_user_callback(soc_i2c0_slave_tx_user_cb_data_ptr);
     }
 }
 
 static void soc_i2c1_slave_tx_callback(uint32_t bytes)
 {
-    if (soc_i2c1_slave_tx_user_callback) {
+    if (soc_i2c_slave[SOC_I2C_1].mode != SLAVE_MODE_USER) {
+        soc_i2c_slave_tx(SOC_I2C_1);
+    } else if (soc_i2c1_slave_tx_user_callback) {
         soc_i2c1_slave_tx_user_callback(soc_i2c1_slave_tx_user_cb_data_ptr);
     }
 }
@@ -245,6 +444,13 @@ int soc_i2c_open_adapter(SOC_I2C_CONTROLLER controller_id, uint32_t address, int
     soc_i2c_err_source[controller_id] = 0;
 
     soc_i2c_set_config(controller_id, &i2c_cfg);
+    if (address) {
+        /* Passes through to the driver until an engine mode is set */
+        if (controller_id == SOC_I2C_0)
+            SET_INTERRUPT_HANDLER(SOC_I2C0_INTERRUPT, soc_i2c0_slave_isr);
+        else
+            SET_INTERRUPT_HANDLER(SOC_I2C1_INTERRUPT, soc_i2c1_slave_isr);
+    }
     soc_i2c_clock_enable(controller_id);
 
     ret = soc_i2c_wait_dev_ready(controller_id, false);
@@ -255,6 +461,7 @@ int soc_i2c_open_adapter(SOC_I2C_CONTROLLER controller_id, uint32_t address, int
 void soc_i2c_close_adapter(SOC_I2C_CONTROLLER controller_id)
 {
     soc_i2c_deconfig(controller_id);
+    soc_i2c_slave[controller_id].mode = SLAVE_MODE_USER;
     soc_i2c_clock_disable(controller_id);
 
     if (controller_id == SOC_I2C_0) {
@@ -284,12 +491,12 @@ void soc_i2c_master_set_slave_address(SOC_I2C_CONTROLLER controller_id, uint32_t
     return;
 }
 
-void soc_i2c_slave_set_rx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t *buffer, uint8_t length)
+void soc_i2c_slave_set_rx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t *buffer, uint32_t length)
 {
     soc_i2c_slave_enable_rx(controller_id, buffer, length);
 }
 
-void soc_i2c_slave_set_tx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t *buffer, uint8_t length)
+void soc_i2c_slave_set_tx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t *buffer, uint32_t length)
 {
     soc_i2c_slave_enable_tx(controller_id, buffer, length);
 }
@@ -329,3 +536,104 @@ int soc_i2c_master_readbytes(SOC_I2C_CONTROLLER controller_id, uint8_t *buf, int
         return ret;
     return length;
 }
+
+int soc_i2c_slave_set_register_map(SOC_I2C_CONTROLLER controller_id, uint8_t *map, uint32_t size,
+                                   uint8_t addr_bytes, uint8_t *stage, uint32_t stage_size,
+                                   void (*onWrite)(uint32_t reg, uint32_t len, void *), void *callerDataPtr)
+{
+    struct soc_i2c_slave *s;
+
+    if (controller_id >= NUM_SOC_I2C || map == NULL || size == 0 ||
+        stage == NULL || stage_size == 0 || addr_bytes < 1 || addr_bytes > 2)
+        return I2C_ERROR;
+
+    s = &soc_i2c_slave[controller_id];
+    s->mode = SLAVE_MODE_USER;
+    s->map = map;
+    s->map_size = size;
+    s->addr_bytes = addr_bytes;
+    s->addr_left = addr_bytes;
+    s->addr_acc = 0;
+    s->reg = 0;
+    s->written = 0;
+    s->on_write = onWrite;
+    s->arg = callerDataPtr;
+    s->stage = stage;
+    s->stage_size = stage_size;
+    s->staged = 0;
+    s->rx_open = false;
+    s->tx_sent = 0;
+    /* Leave the driver no room, soc_i2c_slave_isr() empties the FIFO */
+    soc_i2c_slave_enable_rx(controller_id, stage, 0);
+    s->mode = SLAVE_MODE_REGMAP;
+    return I2C_OK;
+}
+
+uint32_t soc_i2c_slave_register_pointer(SOC_I2C_CONTROLLER controller_id)
+{
+    return soc_i2c_slave[controller_id].reg;
+}
+
+int soc_i2c_slave_set_stream(SOC_I2C_CONTROLLER controller_id, uint8_t *rx_ring, uint32_t rx_size,
+                             uint8_t *stage, uint32_t stage_size,
+                             const uint8_t *(*onRequest)(uint32_t offset, uint32_t *len, void *),
+                             void *callerDataPtr)
+{
+    struct soc_i2c_slave *s;
+
+    if (controller_id >= NUM_SOC_I2C || rx_ring == NULL || rx_size == 0 ||
+        (rx_size & (rx_size - 1)) || stage == NULL || stage_size == 0)
+        return I2C_ERROR;
+
+    s = &soc_i2c_slave[controller_id];
+    s->mode = SLAVE_MODE_USER;
+    s->ring = rx_ring;
+    s->ring_mask = rx_size - 1;
+    s->head = 0;
+    s->tail = 0;
+    s->dropped = 0;
+    s->on_request = onRequest;
+    s->arg = callerDataPtr;
+    s->stage = stage;
+    s->stage_size = stage_size;
+    s->staged = 0;
+    s->rx_open = false;
+    s->tx_sent = 0;
+    /* Leave the driver no room, soc_i2c_slave_isr() empties the FIFO */
+    soc_i2c_slave_enable_rx(controller_id, stage, 0);
+    s->mode = SLAVE_MODE_STREAM;
+    return I2C_OK;
+}
+
+uint32_t soc_i2c_slave_available(SOC_I2C_CONTROLLER controller_id)
+{
+    struct soc_i2c_slave *s = &soc_i2c_slave[controller_id];
+    return s->head - s->tail;
+}
+
+uint32_t soc_i2c_slave_read(SOC_I2C_CONTROLLER controller_id, uint8_t *buf, uint32_t length)
+{
+    struct soc_i2c_slave *s = &soc_i2c_slave[controller_id];
+    uint32_t tail = s->tail;
+    uint32_t n = s->head - tail;
+    uint32_t done = 0;
+
+    if (n > length)
+        n = length;
+    while (done < n) {
+        uint32_t idx = tail & s->ring_mask;
+        uint32_t run = s->ring_mask + 1 - idx;
+        if (run > n - done)
+            run = n - done;
+        memcpy(buf + done, s->ring + idx, run);
+        done += run;
+        tail += run;
+    }
+    s->tail = tail;
+    return done;
+}
+
+uint32_t soc_i2c_slave_rx_dropped(SOC_I2C_CONTROLLER controller_id)
+{
+    return soc_i2c_slave[controller_id].dropped;
+}
@@ -42,8 +42,40 @@ int soc_i2c_master_witebytes(SOC_I2C_CONTROLLER controller_id, uint8_t *bytes, u
 int soc_i2c_master_readbytes(SOC_I2C_CONTROLLER controller_id, uint8_t *buf, int length, bool no_stop);
   void soc_i2c_slave_set_rx_user_callback(SOC_I2C_CONTROLLER controller_id, void (*onReceiveCallback)(int, void *), void *callerDataPtr);
 void soc_i2c_slave_set_tx_user_callback(SOC_I2C_CONTROLLER controller_id, void (*onRequestCallback)(void *), void *callerDataPtr);
-void soc_i2c_slave_set_rx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t *buffer, uint8_t length);
-void soc_i2c_slave_set_tx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t *buffer, uint8_t length);
+void soc_i2c_slave_set_rx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t *buffer, uint32_t length);
+void soc_i2c_slave_set_tx_user_buffer(SOC_I2C_CONTROLLER controller_id, uint8_t *buffer, uint32_t length);
+
+/*
+ * Interrupt driven slave engine, on an adapter opened with a slave address.
+ * Either mode replaces the user callbacks and buffers above. Writes from
+ * the master land in 'stage' first and are moved on in one go per
+ * transaction; writes longer than 'stage' are taken in stage sized pieces.
+ *
+ * Register map: the first 'addr_bytes' (1 or 2, big endian) of each write
+ * set the register pointer, the rest is stored into 'map' from there on,
+ * wrapping at the end, and 'onWrite' is told which range changed. Reads
+ * are served straight out of 'map' from the pointer. Since the controller
+ * prefetches into its FIFO, a read does not move the pointer.
+ */
+int soc_i2c_slave_set_register_map(SOC_I2C_CONTROLLER controller_id, uint8_t *map, uint32_t size,
+                                   uint8_t addr_bytes, uint8_t *stage, uint32_t stage_size,
+                                   void (*onWrite)(uint32_t reg, uint32_t len, void *), void *callerDataPtr);
+uint32_t soc_i2c_slave_register_pointer(SOC_I2C_CONTROLLER controller_id);
+
+/*
+ * Stream: writes are queued in the ring 'rx_ring' ('rx_size' a power of
+ * two) for soc_i2c_slave_read(). Reads are served from whatever 'onRequest'
+ * returns, without copying; it is called with the number of bytes sent so
+ * far in the current read and must keep the data valid until the read ends.
+ */
+int soc_i2c_slave_set_stream(SOC_I2C_CONTROLLER controller_id, uint8_t *rx_ring, uint32_t rx_size,
+                             uint8_t *stage, uint32_t stage_size,
+                             const uint8_t *(*onRequest)(uint32_t offset, uint32_t *len, void *),
+                             void *callerDataPtr);
+uint32_t soc_i2c_slave_available(SOC_I2C_CONTROLLER controller_id);
+uint32_t soc_i2c_slave_read(SOC_I2C_CONTROLLER controller_id, uint8_t *buf, uint32_t length);
+/* Bytes lost because the stream ring was full */
+uint32_t soc_i2c_slave_rx_dropped(SOC_I2C_CONTROLLER controller_id);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,402 @@
+/*
+ * spi_async.c - queued, interrupt driven transfers on the sensing
+ *               subsystem SPI controllers
+ *
+ * Copyright (C) 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The ss_spi driver comes prebuilt in libarc32drv_arduino101.a and only
+ * polls, so the queue runs here, on the controller interrupts the driver
+ * leaves alone. Each controller owns a singly linked queue of
+ * spi_async_submit() descriptors, the head being the one on the wire. The
+ * TX FIFO is topped up from the TX empty interrupt and the RX FIFO drained
+ * from the RX full one, whose threshold follows what is left to receive.
+ * The last interrupt of a transfer completes it and starts the next.
+ * Polled transfers go through spi_async_xfer(), which keeps them off the
+ * wire while the queue runs.
+ */
+
+#include "spi_async.h"
+#include "eiaextensions.h"
+#include "io_config.h"
+#include "portable.h"
+#include "scss_registers.h"
+#include "spi_priv.h"
+
+#define SPI_MAX_CNT (2)
+
+/* FIFO errors; SPI_ERR_CLR_INTR is not usable as defined */
+#define SPI_ERR_INT (RXOIS | RXUIS | TXOIS)
+
+/* As in aux_regs.h, which does not go along with io_config.h */
+#define SPI_AUX_STATUS32        0x00a
+#define SPI_AUX_STATUS32_IE     (1 << 31)
+#define SPI_AUX_IRQ_ACT         0x043
+
+static spi_xfer_t *queue_head[SPI_MAX_CNT];
+static spi_xfer_t *queue_tail[SPI_MAX_CNT];
+/* Held by spi_async_xfer() while it polls; holds back the queue */
+static volatile bool claimed[SPI_MAX_CNT];
+
+static void spi_rx_isr_proc(SPI_CONTROLLER controller_id);
+static void spi_tx_isr_proc(SPI_CONTROLLER controller_id);
+static void spi_err_isr_proc(SPI_CONTROLLER controller_id);
+
+DECLARE_INTERRUPT_HANDLER static void spi_mst0_rx_ISR()
+{
+    spi_rx_isr_proc(SPI_SENSING_0);
+}
+DECLARE_INTERRUPT_HANDLER static void spi_mst0_tx_ISR()
+{
+    spi_tx_isr_proc(SPI_SENSING_0);
+}
+DECLARE_INTERRUPT_HANDLER static void spi_mst0_err_ISR()
+{
+    spi_err_isr_proc(SPI_SENSING_0);
+}
+DECLARE_INTERRUPT_HANDLER static void spi_mst1_rx_ISR()
+{
+    spi_rx_isr_proc(SPI_SENSING_1);
+}
+DECLARE_INTERRUPT_HANDLER static void spi_mst1_tx_ISR()
+{
+    spi_tx_isr_proc(SPI_SENSING_1);
+}
+DECLARE_INTERRUPT_HANDLER static void spi_mst1_err_ISR()
+{
+    spi_err_isr_proc(SPI_SENSING_1);
+}
+
+static spi_info_t spi_async_devs[SPI_MAX_CNT] = {
+    {.instID = 0,
+     .reg_base = AR_IO_SPI_MST0_CTRL,
+     .fifo_depth = IO_SPI_MST0_FS,
+     .rx_vector = IO_SPI_MST0_INT_RX_AVAIL,
+     .tx_vector = IO_SPI_MST0_INT_TX_REQ,
+     .err_vector = IO_SPI_MST0_INT_ERR,
+     .rx_isr = spi_mst0_rx_ISR,
+     .tx_isr = spi_mst0_tx_ISR,
+     .err_isr = spi_mst0_err_ISR,
+     .spi_rx_avail_mask = SCSS_REGISTER_BASE + INT_SS_SPI_0_RX_AVAIL_MASK,
+     .spi_tx_req_mask = SCSS_REGISTER_BASE + INT_SS_SPI_0_TX_REQ_MASK,
+     .spi_err_mask = SCSS_REGISTER_BASE + INT_SS_SPI_0_ERR_INT_MASK},
+    {.instID = 1,
+     .reg_base = AR_IO_SPI_MST1_CTRL,
+     .fifo_depth = IO_SPI_MST1_FS,
+     .rx_vector = IO_SPI_MST1_INT_RX_AVAIL,
+     .tx_vector = IO_SPI_MST1_INT_TX_REQ,
+     .err_vector = IO_SPI_MST1_INT_ERR,
+     .rx_isr = spi_mst1_rx_ISR,
+     .tx_isr = spi_mst1_tx_ISR,
+     .err_isr = spi_mst1_err_ISR,
+     .spi_rx_avail_mask = SCSS_REGISTER_BASE + INT_SS_SPI_1_RX_AVAIL_MASK,
+     .spi_tx_req_mask = SCSS_REGISTER_BASE + INT_SS_SPI_1_TX_REQ_MASK,
+     .spi_err_mask = SCSS_REGISTER_BASE + INT_SS_SPI_1_ERR_INT_MASK},
+};
+
+void spi_async_init(SPI_CONTROLLER controller_id, SPI_SLAVE_ENABLE slave)
+{
+    spi_info_pt dev = &spi_async_devs[controller_id];
+
+    /* ss_spi_init() left the controller interrupts masked */
+    dev->slave = slave;
+    dev->state = SPI_STATE_READY;
+    SET_INTERRUPT_HANDLER(dev->rx_vector, dev->rx_isr);
+    SET_INTERRUPT_HANDLER(dev->tx_vector, dev->tx_isr);
+    SET_INTERRUPT_HANDLER(dev->err_vector, dev->err_isr);
+    /* Setup SPI Interrupt Routing Mask Registers to allow interrupts through */
+    MMIO_REG_VAL(dev->spi_rx_avail_mask) &= ENABLE_SSS_INTERRUPTS;
+    MMIO_REG_VAL(dev->spi_tx_req_mask) &= ENABLE_SSS_INTERRUPTS;
+    MMIO_REG_VAL(dev->spi_err_mask) &= ENABLE_SSS_INTERRUPTS;
+}
+
+void spi_async_disable(SPI_CONTROLLER controller_id)
+{
+    spi_info_pt dev = &spi_async_devs[controller_id];
+    uint32_t saved = interrupt_lock();
+
+    /* Whatever is queued or running fails */
+    WRITE_ARC_REG(SPI_DISABLE_INT, dev->reg_base + INTR_MASK);
+    WRITE_ARC_REG(SPI_DISABLE, dev->reg_base + SPIEN);
+    while (queue_head[controller_id]) {
+        spi_xfer_t *xfer = queue_head[controller_id];
+
+        queue_head[controller_id] = xfer->next;
+        xfer->next = NULL;
+        xfer->status = DRV_RC_FAIL;
+        if (xfer->done)
+            xfer->done(xfer);
+    }
+    queue_tail[controller_id] = NULL;
+    dev->state = SPI_STATE_READY;
+    interrupt_unlock(saved);
+
+    ss_spi_disable(controller_id);
+}
+
+/* Select the slave and the transfer mode for 'tx_cnt' bytes out and
+ * 'rx_cnt' back, leaving the controller disabled; returns SPIEN to write
+ * with SPI_ENABLE to start */
+static uint32_t spi_setup(spi_info_pt dev, unsigned tx_cnt, unsigned rx_cnt)
+{
+    uint32_t spien = 0;
+    uint32_t ctrl = 0;
+
+    spien = READ_ARC_REG(dev->reg_base + SPIEN);
+    spien &= SPI_ENB_SET_MASK;
+    spien &= SPI_SER_SET_MASK;
+    spien |= (dev->slave << 4);
+    WRITE_ARC_REG(spien, dev->reg_base + SPIEN);
+
+    ctrl = READ_ARC_REG(dev->reg_base + CTRL) & SPI_NDF_SET_MASK &
+           SPI_TMOD_SET_MASK;
+    ctrl |= (rx_cnt - 1) << 16;
+    if (tx_cnt == 0) {
+        ctrl |= (SPI_RX_ONLY << 8);
+    } else if (rx_cnt == 0) {
+        ctrl |= (SPI_TX_ONLY << 8);
+    } else {
+        ctrl |= (SPI_EPROM_RD << 8);
+    }
+    WRITE_ARC_REG(ctrl, dev->reg_base + CTRL);
+
+    return spien;
+}
+
+/* Wait for the queue to go idle and hold it back; false if that cannot
+ * happen because its interrupts cannot come */
+static bool spi_claim(SPI_CONTROLLER controller_id)
+{
+    spi_info_pt dev = &spi_async_devs[controller_id];
+    uint32_t saved;
+
+    for (;;) {
+        saved = interrupt_lock();
+        if (dev->state != SPI_STATE_TRANSMIT && !claimed[controller_id]) {
+            claimed[controller_id] = true;
+            interrupt_unlock(saved);
+            return true;
+        }
+        interrupt_unlock(saved);
+        if (!spi_async_can_wait())
+            return false;
+    }
+}
+
+static void spi_start_next(SPI_CONTROLLER controller_id);
+
+static void spi_release(SPI_CONTROLLER controller_id)
+{
+    uint32_t saved = interrupt_lock();
+
+    claimed[controller_id] = false;
+    spi_start_next(controller_id);
+    interrupt_unlock(saved);
+}
+
+int spi_async_xfer(SPI_CONTROLLER controller_id, uint8_t *buf,
+                   unsigned tx_cnt, unsigned rx_cnt)
+{
+    if (!spi_claim(controller_id))
+        return DRV_RC_CONTROLLER_IN_USE;
+    ss_spi_xfer(controller_id, buf, tx_cnt, rx_cnt);
+    spi_release(controller_id);
+    return DRV_RC_OK;
+}
+
+/* Interrupt once the RX FIFO holds what is left to receive, up to half
+ * of it */
+static void spi_set_rx_threshold(spi_info_pt dev)
+{
+    uint32_t left = dev->rx_len - dev->rx_count;
+    uint32_t half = dev->fifo_depth / 2;
+
+    if (left > half)
+        left = half;
+    WRITE_ARC_REG((SPI_TX_FIFO_THRESHOLD << 16) | (left ? left - 1 : 0),
+                  dev->reg_base + FTLR);
+}
+
+/* Top up the TX FIFO from the running transfer */
+static void spi_fill(spi_info_pt dev)
+{
+    uint32_t room = dev->fifo_depth - READ_ARC_REG(dev->reg_base + TXFLR);
+
+    while (room-- && dev->tx_count < dev->tx_len)
+        WRITE_ARC_REG(SPI_PUSH_DATA | dev->tx_buf[dev->tx_count++],
+                      dev->reg_base + DR);
+}
+
+/* Put the head of the queue on the wire unless something already is;
+ * interrupts must be locked */
+static void spi_start_next(SPI_CONTROLLER controller_id)
+{
+    spi_info_pt dev = &spi_async_devs[controller_id];
+    spi_xfer_t *xfer = queue_head[controller_id];
+    uint32_t spien, mask = SPI_ERR_INT;
+
+    if (!xfer || dev->state == SPI_STATE_TRANSMIT || claimed[controller_id])
+        return;
+
+    dev->state = SPI_STATE_TRANSMIT;
+    dev->tx_buf = dev->rx_buf = xfer->buf;
+    dev->tx_len = xfer->tx_cnt;
+    dev->rx_len = xfer->rx_cnt;
+    dev->tx_count = dev->rx_count = 0;
+
+    spien = spi_setup(dev, xfer->tx_cnt, xfer->rx_cnt);
+    spi_set_rx_threshold(dev);
+
+    // Assert the slave-select and start the SPI transfer
+    WRITE_ARC_REG(spien | SPI_ENABLE, dev->reg_base + SPIEN);
+    if (dev->tx_len) {
+        spi_fill(dev);
+        mask |= TXEIS;
+    } else {
+        WRITE_ARC_REG(SPI_PUSH_DATA | 0x56, dev->reg_base + DR);
+    }
+    if (dev->rx_len)
+        mask |= RXFIS;
+    WRITE_ARC_REG(mask, dev->reg_base + INTR_MASK);
+}
+
+/* Pop the head, report it and start the next one; from the controller's
+ * interrupts */
+static void spi_finish(SPI_CONTROLLER controller_id, int status)
+{
+    spi_info_pt dev = &spi_async_devs[controller_id];
+    spi_xfer_t *xfer = queue_head[controller_id];
+
+    // De-assert the slave-select and end the SPI transfer
+    WRITE_ARC_REG(SPI_DISABLE_INT, dev->reg_base + INTR_MASK);
+    WRITE_ARC_REG(0, dev->reg_base + SPIEN);
+    dev->state = SPI_STATE_READY;
+
+    queue_head[controller_id] = xfer->next;
+    if (queue_head[controller_id] == NULL)
+        queue_tail[controller_id] = NULL;
+    xfer->next = NULL;
+    xfer->status = status;
+    if (xfer->done)
+        xfer->done(xfer);
+
+    spi_start_next(controller_id);
+}
+
+static void spi_rx_isr_proc(SPI_CONTROLLER controller_id)
+{
+    spi_info_pt dev = &spi_async_devs[controller_id];
+    uint32_t level;
+
+    if (dev->state != SPI_STATE_TRANSMIT) {
+        WRITE_ARC_REG(SPI_DISABLE_INT, dev->reg_base + INTR_MASK);
+        return;
+    }
+
+    level = READ_ARC_REG(dev->reg_base + RXFLR);
+    for (; level > 0 && dev->rx_count < dev->rx_len; level--) {
+        WRITE_ARC_REG(SPI_POP_DATA, dev->reg_base + DR);
+        dev->rx_buf[dev->rx_count++] = READ_ARC_REG(dev->reg_base + DR);
+        READ_ARC_REG(dev->reg_base +
+                     RXFLR); /* Extra read of RXFLR, as when polling */
+    }
+
+    if (dev->rx_count == dev->rx_len)
+        spi_finish(controller_id, DRV_RC_OK);
+    else
+        spi_set_rx_threshold(dev);
+}
+
+static void spi_tx_isr_proc(SPI_CONTROLLER controller_id)
+{
+    spi_info_pt dev = &spi_async_devs[controller_id];
+
+    if (dev->state != SPI_STATE_TRANSMIT) {
+        WRITE_ARC_REG(SPI_DISABLE_INT, dev->reg_base + INTR_MASK);
+        return;
+    }
+
+    spi_fill(dev);
+    if (dev->tx_count < dev->tx_len)
+        return;
+
+    if (dev->rx_len) {
+        /* All sent; the RX side finishes the transfer */
+        WRITE_ARC_REG(READ_ARC_REG(dev->reg_base + INTR_MASK) & ~TXEIS,
+                      dev->reg_base + INTR_MASK);
+        return;
+    }
+    /* Transmit-only: at most the threshold's worth is left to shift out */
+    while (!(READ_ARC_REG(dev->reg_base + SR) & SPI_STATUS_TFE))
+        ;
+    while (READ_ARC_REG(dev->reg_base + SR) & SPI_STATUS_BUSY)
+        ;
+    spi_finish(controller_id, DRV_RC_OK);
+}
+
+static void spi_err_isr_proc(SPI_CONTROLLER controller_id)
+{
+    spi_info_pt dev = &spi_async_devs[controller_id];
+
+    WRITE_ARC_REG(SPI_ERR_INT, dev->reg_base + CLR_INTR);
+    if (dev->state != SPI_STATE_TRANSMIT) {
+        WRITE_ARC_REG(SPI_DISABLE_INT, dev->reg_base + INTR_MASK);
+        return;
+    }
+    spi_finish(controller_id, DRV_RC_FAIL);
+}
+
+DRIVER_API_RC spi_async_submit(SPI_CONTROLLER controller_id, spi_xfer_t *xfer)
+{
+    uint32_t saved;
+    spi_xfer_t *cur;
+
+    if (controller_id >= SPI_MAX_CNT || xfer == NULL || xfer->buf == NULL ||
+        (xfer->tx_cnt == 0 && xfer->rx_cnt == 0))
+        return DRV_RC_INVALID_OPERATION;
+
+    saved = interrupt_lock();
+    for (cur = queue_head[controller_id]; cur; cur = cur->next) {
+        if (cur == xfer) {
+            interrupt_unlock(saved);
+            return DRV_RC_INVALID_OPERATION;
+        }
+    }
+    xfer->status = SPI_PENDING;
+    xfer->next = NULL;
+    if (queue_tail[controller_id])
+        queue_tail[controller_id]->next = xfer;
+    else
+        queue_head[controller_id] = xfer;
+    queue_tail[controller_id] = xfer;
+    spi_start_next(controller_id);
+    interrupt_unlock(saved);
+    return DRV_RC_OK;
+}
+
+bool spi_async_busy(SPI_CONTROLLER controller_id)
+{
+    return queue_head[controller_id] != NULL;
+}
+
+bool spi_async_can_wait(void)
+{
+    return (READ_ARC_REG(SPI_AUX_STATUS32) & SPI_AUX_STATUS32_IE) &&
+           READ_ARC_REG(SPI_AUX_IRQ_ACT) == 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * spi_async.h - queued, interrupt driven transfers on the sensing
+ *               subsystem SPI controllers
+ *
+ * Copyright (C) 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef spi_async_h
+#define spi_async_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include "ss_spi.h"
+#include "data_type.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Status of a transfer that has not completed yet; finished ones hold
+ * DRV_RC_OK, or DRV_RC_FAIL after a FIFO overflow/underflow or when the
+ * controller was disabled under them */
+#define SPI_PENDING DRV_RC_TOTAL_RC_CODE
+
+typedef struct spi_xfer spi_xfer_t;
+
+/* Called from the controller's interrupt handler once the transfer is
+ * over and slave select released. It may submit further transfers,
+ * including itself. */
+typedef void (*spi_xfer_cb)(spi_xfer_t *xfer);
+
+/*
+ * One slave select cycle, as for ss_spi_xfer(): 'tx_cnt' bytes are sent
+ * from 'buf', then 'rx_cnt' bytes are clocked in over the start of it.
+ * The descriptor and the buffer belong to the caller and must stay valid
+ * until the transfer completes.
+ */
+struct spi_xfer {
+    uint8_t *buf;
+    unsigned tx_cnt;
+    unsigned rx_cnt;
+    spi_xfer_cb done;
+    void *arg;              /* free for the caller */
+    volatile int status;
+
+    /* private */
+    spi_xfer_t *next;
+};
+
+/* Take over the interrupts of a controller set up with ss_spi_init() for
+ * 'slave'; the ss_spi driver leaves them unused */
+void spi_async_init(SPI_CONTROLLER controller_id, SPI_SLAVE_ENABLE slave);
+
+/* Fail whatever is queued or running, then ss_spi_disable() */
+void spi_async_disable(SPI_CONTROLLER controller_id);
+
+/* Queue a transfer. It runs from the FIFO threshold interrupts once the
+ * ones before it are done. Returns DRV_RC_OK once queued, or
+ * DRV_RC_INVALID_OPERATION if the descriptor is already queued or empty. */
+DRIVER_API_RC spi_async_submit(SPI_CONTROLLER controller_id, spi_xfer_t *xfer);
+
+/* ss_spi_xfer() that waits for queued transfers to finish and holds the
+ * queue back while it polls. Where their interrupts cannot come, with
+ * interrupts disabled or from an interrupt handler, it returns
+ * DRV_RC_CONTROLLER_IN_USE instead, leaving 'buf' as it was; otherwise
+ * DRV_RC_OK. */
+int spi_async_xfer(SPI_CONTROLLER controller_id, uint8_t *buf,
+                   unsigned tx_cnt, unsigned rx_cnt);
+
+/* true while transfers are queued or running */
+bool spi_async_busy(SPI_CONTROLLER controller_id);
+
+/* Whether transfers can complete while the caller waits on them: not with
+ * interrupts disabled, nor from an interrupt handler */
+bool spi_async_can_wait(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* spi_async_h */
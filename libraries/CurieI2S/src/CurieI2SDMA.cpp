@@ -23,6 +23,7 @@
 #include "CurieI2SDMA.h"
 #include "soc_i2s.h"
 #include "soc_dma.h"
+#include "dma_shared.h"
 #include "variant.h"
 #include <interrupt.h>
 
@@ -86,7 +87,7 @@ int Curie_I2SDMA::iniTX()
 {
 	muxTX(1);
 	soc_i2s_init();
-	soc_dma_init();
+	dma_shared_init();
 	return I2S_DMA_OK; 
 }
 
@@ -94,7 +95,7 @@ int Curie_I2SDMA::iniRX()
 {
 	muxRX(1);
 	soc_i2s_init();
-	soc_dma_init();
+	dma_shared_init();
 	return I2S_DMA_OK; 
 }
 
@@ -36,26 +36,140 @@ THE SOFTWARE.
 #define BMI160_ACCEL_POWERUP_DELAY_MS 10
 #define BMI160_GYRO_POWERUP_DELAY_MS 100
 
+/* Shadowed configuration registers, one bit per register of the window in
+ * the masks. Left out are the reserved and magnetometer
+ * interface registers, NVM/self-test control and the step counter, which
+ * are not plain configuration */
+#define BMI160_CACHE_BIT(reg)   (1ULL << ((reg) - BMI160_CACHE_FIRST))
+#define BMI160_CACHE_RANGE(first, last) \
+    ((BMI160_CACHE_BIT(last) << 1) - BMI160_CACHE_BIT(first))
+#define BMI160_CACHE_MASK \
+    (BMI160_CACHE_RANGE(BMI160_RA_ACCEL_CONF, BMI160_RA_FIFO_CONFIG_1) | \
+     BMI160_CACHE_RANGE(BMI160_RA_INT_EN_0, BMI160_RA_FOC_CONF) | \
+     BMI160_CACHE_RANGE(BMI160_RA_OFFSET_0, BMI160_RA_OFFSET_6) | \
+     BMI160_CACHE_RANGE(BMI160_RA_STEP_CONF_0, BMI160_RA_STEP_CONF_1))
+/* Written by the device itself during fast offset compensation */
+#define BMI160_CACHE_OFFSETS \
+    BMI160_CACHE_RANGE(BMI160_RA_OFFSET_0, BMI160_RA_OFFSET_6)
+
+/* Gap required after each write while both sensors are suspended, which
+ * also rules out burst writes */
+#define BMI160_SUSPEND_WRITE_DELAY_US 450
+
 /* Test the sign bit and set remaining MSBs if sign bit is set */
 #define BMI160_SIGN_EXTEND(val, from) \
     (((val) & (1 << ((from) - 1))) ? (val | (((1 << (1 + (sizeof(val) << 3) - (from))) - 1) << (from))) : val)
 
 /******************************************************************************/
 
+bool BMI160Class::reg_cacheable(uint8_t reg)
+{
+    return reg >= BMI160_CACHE_FIRST &&
+           reg < BMI160_CACHE_FIRST + BMI160_CACHE_SIZE &&
+           (BMI160_CACHE_MASK & BMI160_CACHE_BIT(reg));
+}
+
 uint8_t BMI160Class::reg_read (uint8_t reg)
 {
     uint8_t buffer[1];
+
+    if (reg_cacheable(reg) && (reg_valid & BMI160_CACHE_BIT(reg)))
+        return reg_cache[reg - BMI160_CACHE_FIRST];
+
     buffer[0] = reg;
-    serial_buffer_transfer(buffer, 1, 1);
+    if (serial_buffer_transfer(buffer, 1, 1) != 0) {
+        /* nothing read; the next read goes to the device again */
+        if (reg_cacheable(reg))
+            reg_valid &= ~BMI160_CACHE_BIT(reg);
+        return buffer[0];
+    }
+    if (reg_cacheable(reg)) {
+        reg_cache[reg - BMI160_CACHE_FIRST] = buffer[0];
+        reg_valid |= BMI160_CACHE_BIT(reg);
+    }
     return buffer[0];
 }
 
 void BMI160Class::reg_write(uint8_t reg, uint8_t data)
 {
     uint8_t buffer[2];
+
+    if (reg_cacheable(reg)) {
+        reg_cache[reg - BMI160_CACHE_FIRST] = data;
+        reg_valid |= BMI160_CACHE_BIT(reg);
+        if (reg_hold) {
+            reg_dirty |= BMI160_CACHE_BIT(reg);
+            return;
+        }
+    } else if (reg_dirty) {
+        /* keep the order of writes, e.g. FOC_CONF before START_FOC */
+        reg_flush();
+    }
+
     buffer[0] = reg;
     buffer[1] = data;
-    serial_buffer_transfer(buffer, 2, 0);
+    if (serial_buffer_transfer(buffer, 2, 0) != 0) {
+        /* the device did not get it, so the cache cannot tell */
+        if (reg_cacheable(reg))
+            reg_valid &= ~BMI160_CACHE_BIT(reg);
+        return;
+    }
+
+    if (reg == BMI160_RA_CMD) {
+        if (data == BMI160_CMD_SOFT_RESET) {
+            reg_valid = 0;
+            reg_dirty = 0;
+        } else if (data == BMI160_CMD_START_FOC) {
+            reg_valid &= ~BMI160_CACHE_OFFSETS;
+        }
+    }
+}
+
+/* Fill the cache in one burst read of the whole window */
+void BMI160Class::reg_load()
+{
+    uint8_t buffer[BMI160_CACHE_SIZE];
+    unsigned i;
+
+    reg_flush();
+    buffer[0] = BMI160_CACHE_FIRST;
+    if (serial_buffer_transfer(buffer, 1, BMI160_CACHE_SIZE) != 0) {
+        reg_valid = 0;
+        return;
+    }
+    for (i = 0; i < BMI160_CACHE_SIZE; i++)
+        reg_cache[i] = buffer[i];
+    reg_valid = BMI160_CACHE_MASK;
+}
+
+/* Write the dirty registers out, each run of consecutive ones in a
+ * single burst */
+void BMI160Class::reg_flush()
+{
+    uint8_t buffer[1 + BMI160_CACHE_SIZE];
+    bool burst = !!sensors_enabled;
+    unsigned first, last;
+
+    first = 0;
+    while (reg_dirty) {
+        while (!(reg_dirty & (1ULL << first)))
+            first++;
+        last = first;
+        while (burst && last + 1 < BMI160_CACHE_SIZE &&
+               (reg_dirty & (1ULL << (last + 1))))
+            last++;
+
+        buffer[0] = BMI160_CACHE_FIRST + first;
+        memcpy(&buffer[1], &reg_cache[first], last - first + 1);
+        if (serial_buffer_transfer(buffer, last - first + 2, 0) != 0) {
+            /* lost, as an uncached write would be; read them back */
+            reg_valid &= ~((2ULL << last) - (1ULL << first));
+        }
+        reg_dirty &= ~((2ULL << last) - (1ULL << first));
+        if (!burst)
+            delayMicroseconds(BMI160_SUSPEND_WRITE_DELAY_US);
+        first = last + 1;
+    }
 }
 
 void BMI160Class::reg_write_bits(uint8_t reg, uint8_t data, unsigned pos, unsigned len)
@@ -93,6 +207,7 @@ int BMI160Class::isBitSet(uint8_t value, unsigned bit)
 void BMI160Class::initialize(unsigned int flags)
 {
     sensors_enabled = 0;
+    reg_hold = 0;
 
     /* Issue a soft-reset to bring the device into a clean state */
     reg_write(BMI160_RA_CMD, BMI160_CMD_SOFT_RESET);
@@ -130,6 +245,11 @@ void BMI160Class::initialize(unsigned int flags)
         sensors_enabled |= GYRO;
     }
 
+    /* The configuration is at its reset values, with offsets loaded from
+     * NVM: shadow all of it at once */
+    reg_load();
+
+    beginConfig();
     setFullScaleGyroRange(BMI160_GYRO_RANGE_250, 250.0f);
     setFullScaleAccelRange(BMI160_ACCEL_RANGE_2G, 2.0f);
 
@@ -137,6 +257,33 @@ void BMI160Class::initialize(unsigned int flags)
     reg_write(BMI160_RA_INT_MAP_0, 0xFF);
     reg_write(BMI160_RA_INT_MAP_1, 0xF0);
     reg_write(BMI160_RA_INT_MAP_2, 0x00);
+    commit();
+}
+
+/** Hold configuration writes until the matching commit().
+ * Configuration registers are shadowed: once known, they are read from the
+ * shadow copy instead of over SPI, so read-modify-write setters cost a
+ * single write. Between beginConfig() and commit() the writes only update
+ * the shadow copy, and commit() sends them in as few SPI bursts as
+ * possible, one per run of consecutive registers. Calls nest; only the
+ * outermost commit() writes. A command, such as resetFIFO(), sends the
+ * held writes first so the order is kept. Data and status registers are
+ * always read from the device.
+ * @see commit()
+ */
+void BMI160Class::beginConfig()
+{
+    reg_hold++;
+}
+
+/** Write the configuration held since beginConfig().
+ * @see beginConfig()
+ */
+void BMI160Class::commit()
+{
+    if (reg_hold > 0 && --reg_hold > 0)
+        return;
+    reg_flush();
 }
 
 /** Get Device ID.
@@ -363,6 +510,8 @@ void BMI160Class::setFullScaleGyroRange(uint8_t range, float real) {
                    BMI160_GYRO_RANGE_SEL_BIT,
                    BMI160_GYRO_RANGE_SEL_LEN);
     gyro_range = real;
+    gyro_scale = real / BMI160_SENSOR_LOW;
+    gyro_scale_q16 = (int32_t)(real * (65536.0f / BMI160_SENSOR_LOW));
 }
 
 /** Get full-scale accelerometer range.
@@ -396,6 +545,8 @@ void BMI160Class::setFullScaleAccelRange(uint8_t range, float real) {
                    BMI160_ACCEL_RANGE_SEL_BIT,
                    BMI160_ACCEL_RANGE_SEL_LEN);
     accel_range = real;
+    accel_scale = real / BMI160_SENSOR_LOW;
+    accel_scale_q16 = (int32_t)(real * (65536.0f / BMI160_SENSOR_LOW));
 }
 
 /** Get accelerometer offset compensation enabled value.
@@ -1502,6 +1653,30 @@ void BMI160Class::setIntFIFOBufferFullEnabled(bool enabled) {
                    1);
 }
 
+/** Get FIFO Watermark interrupt enabled status.
+ * Will be set 0 for disabled, 1 for enabled.
+ * @return Current interrupt enabled status
+ * @see BMI160_RA_INT_EN_1
+ * @see BMI160_FWM_EN_BIT
+ **/
+bool BMI160Class::getIntFIFOWatermarkEnabled() {
+    return !!(reg_read_bits(BMI160_RA_INT_EN_1,
+                            BMI160_FWM_EN_BIT,
+                            1));
+}
+
+/** Set FIFO Watermark interrupt enabled status.
+ * @param enabled New interrupt enabled status
+ * @see getIntFIFOWatermarkEnabled()
+ * @see BMI160_RA_INT_EN_1
+ * @see BMI160_FWM_EN_BIT
+ **/
+void BMI160Class::setIntFIFOWatermarkEnabled(bool enabled) {
+    reg_write_bits(BMI160_RA_INT_EN_1, enabled ? 0x1 : 0x0,
+                   BMI160_FWM_EN_BIT,
+                   1);
+}
+
 /** Get Data Ready interrupt enabled setting.
  * This event occurs each time a write operation to all of the sensor registers
  * has been completed. Will be set 0 for disabled, 1 for enabled.
@@ -1591,6 +1766,27 @@ uint16_t BMI160Class::getFIFOCount() {
     return (((int16_t)buffer[1]) << 8) | buffer[0];
 }
 
+/** Get FIFO watermark level.
+ * The FIFO watermark interrupt is raised once the FIFO holds this many
+ * bytes. The register counts in units of 4 bytes.
+ * @return Current watermark in bytes
+ * @see BMI160_RA_FIFO_CONFIG_0
+ */
+uint16_t BMI160Class::getFIFOWatermark() {
+    return reg_read(BMI160_RA_FIFO_CONFIG_0) * 4;
+}
+
+/** Set FIFO watermark level.
+ * @param bytes New watermark in bytes, rounded down to a multiple of 4
+ * @see getFIFOWatermark()
+ * @see BMI160_RA_FIFO_CONFIG_0
+ */
+void BMI160Class::setFIFOWatermark(uint16_t bytes) {
+    if (bytes > BMI160_FIFO_SIZE - 4)
+        bytes = BMI160_FIFO_SIZE - 4;
+    reg_write(BMI160_RA_FIFO_CONFIG_0, bytes / 4);
+}
+
 /** Reset the FIFO.
  * This command clears all data in the FIFO buffer.  It is recommended
  * to invoke this after reconfiguring the FIFO.
@@ -1643,6 +1839,33 @@ void BMI160Class::setFIFOHeaderModeEnabled(bool enabled) {
                    1);
 }
 
+/** Get FIFO sensortime frame enabled status.
+ * When this bit is set to 1, a sensortime frame is returned once the FIFO
+ * has been read empty, giving the sensortime of the last frame read.
+ * Header-mode only.
+ *
+ * @return Current FIFO sensortime frame enabled status
+ * @see BMI160_RA_FIFO_CONFIG_1
+ * @see BMI160_FIFO_TIME_EN_BIT
+ */
+bool BMI160Class::getFIFOTimeEnabled() {
+    return !!(reg_read_bits(BMI160_RA_FIFO_CONFIG_1,
+                            BMI160_FIFO_TIME_EN_BIT,
+                            1));
+}
+
+/** Set FIFO sensortime frame enabled status.
+ * @param enabled New FIFO sensortime frame enabled status
+ * @see getFIFOTimeEnabled()
+ * @see BMI160_RA_FIFO_CONFIG_1
+ * @see BMI160_FIFO_TIME_EN_BIT
+ */
+void BMI160Class::setFIFOTimeEnabled(bool enabled) {
+    reg_write_bits(BMI160_RA_FIFO_CONFIG_1, enabled ? 0x1 : 0,
+                   BMI160_FIFO_TIME_EN_BIT,
+                   1);
+}
+
 /** Get data frames from FIFO buffer.
  * This register is used to read and write data frames from the FIFO buffer.
  * Data is written to the FIFO in order of DATA register number (from lowest
@@ -1665,13 +1888,15 @@ void BMI160Class::setFIFOHeaderModeEnabled(bool enabled) {
  * check FIFO_LENGTH to ensure that the FIFO buffer is not read when empty (see
  * @getFIFOCount()).
  *
- * @return Data frames from FIFO buffer
+ * @return 0 once the data frames are in 'data', or the serial transfer's
+ * error, in which case 'data' holds no frames
  */
-void BMI160Class::getFIFOBytes(uint8_t *data, uint16_t length) {
+int BMI160Class::getFIFOBytes(uint8_t *data, uint16_t length) {
     if (length) {
         data[0] = BMI160_RA_FIFO_DATA;
-        serial_buffer_transfer(data, 1, length);
+        return serial_buffer_transfer(data, 1, length);
     }
+    return 0;
 }
 
 /** Get full set of interrupt status bits from INT_STATUS[0] register.
@@ -2062,6 +2287,20 @@ bool BMI160Class::getIntFIFOBufferFullStatus() {
                             1));
 }
 
+/** Get FIFO Watermark interrupt status.
+ * This bit is set to 1 while the FIFO holds at least as many bytes as the
+ * watermark, and clears to 0 once it has been read below it.
+ * @return Current interrupt status
+ * @see BMI160_RA_INT_STATUS_1
+ * @see BMI160_FWM_INT_BIT
+ * @see setFIFOWatermark()
+ */
+bool BMI160Class::getIntFIFOWatermarkStatus() {
+    return !!(reg_read_bits(BMI160_RA_INT_STATUS_1,
+                            BMI160_FWM_INT_BIT,
+                            1));
+}
+
 /** Get Data Ready interrupt status.
  * This bit automatically sets to 1 when a Data Ready interrupt has been
  * generated. The bit clears to 0 after the data registers have been read.
@@ -75,6 +75,7 @@ THE SOFTWARE.
 #define BMI160_S_TAP_INT_BIT        5
 #define BMI160_NOMOTION_INT_BIT     7
 #define BMI160_FFULL_INT_BIT        5
+#define BMI160_FWM_INT_BIT          6
 #define BMI160_DRDY_INT_BIT         4
 #define BMI160_LOW_G_INT_BIT        3
 #define BMI160_HIGH_G_INT_BIT       2
@@ -108,6 +109,27 @@ THE SOFTWARE.
 #define BMI160_FIFO_DATA_INVALID    0x80
 #define BMI160_RA_FIFO_DATA         0x24
 
+#define BMI160_FIFO_LENGTH_MASK     0x07FF
+#define BMI160_FIFO_SIZE            1024
+
+/* Header-mode frame headers; regular frames carry the sensor bits below
+ * and interrupt tags in bits 1:0 */
+#define BMI160_FIFO_HEADER_MODE_MASK 0xC0
+#define BMI160_FIFO_HEADER_REGULAR  0x80
+#define BMI160_FIFO_HEADER_MAG      0x10
+#define BMI160_FIFO_HEADER_GYR      0x08
+#define BMI160_FIFO_HEADER_ACC      0x04
+#define BMI160_FIFO_HEADER_SKIP     0x40
+#define BMI160_FIFO_HEADER_TIME     0x44
+#define BMI160_FIFO_HEADER_CONFIG   0x48
+
+#define BMI160_FIFO_MAG_LEN         8
+#define BMI160_FIFO_GYR_LEN         6
+#define BMI160_FIFO_ACC_LEN         6
+#define BMI160_FIFO_TIME_LEN        3
+/* Largest accelerometer + gyro frame, header included */
+#define BMI160_FIFO_FRAME_MAX       (1 + BMI160_FIFO_GYR_LEN + BMI160_FIFO_ACC_LEN)
+
 #define BMI160_ACCEL_RATE_SEL_BIT    0
 #define BMI160_ACCEL_RATE_SEL_LEN    4
 
@@ -120,6 +142,7 @@ THE SOFTWARE.
 #define BMI160_RA_GYRO_CONF         0X42
 #define BMI160_RA_GYRO_RANGE        0X43
 
+#define BMI160_FIFO_TIME_EN_BIT     1
 #define BMI160_FIFO_HEADER_EN_BIT   4
 #define BMI160_FIFO_ACC_EN_BIT      6
 #define BMI160_FIFO_GYR_EN_BIT      7
@@ -141,6 +164,7 @@ THE SOFTWARE.
 #define BMI160_STEP_EN_BIT          3
 #define BMI160_DRDY_EN_BIT          4
 #define BMI160_FFULL_EN_BIT         5
+#define BMI160_FWM_EN_BIT           6
 
 #define BMI160_RA_INT_EN_0          0x50
 #define BMI160_RA_INT_EN_1          0x51
@@ -267,6 +291,10 @@ THE SOFTWARE.
 
 #define BMI160_RA_CMD               0x7E
 
+/* Window of configuration registers shadowed by BMI160Class */
+#define BMI160_CACHE_FIRST          BMI160_RA_ACCEL_CONF
+#define BMI160_CACHE_SIZE           (BMI160_RA_STEP_CONF_1 - BMI160_CACHE_FIRST + 1)
+
 /* Bit flags for selecting individual sensors */
 typedef enum {
     GYRO = 0x1,
@@ -478,6 +506,8 @@ typedef enum {
 class BMI160Class {
     public:
         void initialize(unsigned int flags);
+        void beginConfig();
+        void commit();
         bool testConnection();
 
         bool isEnabled(unsigned int sensors);
@@ -587,6 +617,8 @@ class BMI160Class {
 
         bool getIntFIFOBufferFullEnabled();
         void setIntFIFOBufferFullEnabled(bool enabled);
+        bool getIntFIFOWatermarkEnabled();
+        void setIntFIFOWatermarkEnabled(bool enabled);
         bool getIntDataReadyEnabled();
         void setIntDataReadyEnabled(bool enabled);
 
@@ -602,6 +634,7 @@ class BMI160Class {
         bool getIntTapStatus();
         bool getIntDoubleTapStatus();
         bool getIntFIFOBufferFullStatus();
+        bool getIntFIFOWatermarkStatus();
         bool getIntDataReadyStatus();
 
         void getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz);
@@ -640,10 +673,14 @@ class BMI160Class {
 
         bool getFIFOHeaderModeEnabled();
         void setFIFOHeaderModeEnabled(bool enabled);
+        bool getFIFOTimeEnabled();
+        void setFIFOTimeEnabled(bool enabled);
         void resetFIFO();
 
         uint16_t getFIFOCount();
-        void getFIFOBytes(uint8_t *data, uint16_t length);
+        uint16_t getFIFOWatermark();
+        void setFIFOWatermark(uint16_t bytes);
+        int getFIFOBytes(uint8_t *data, uint16_t length);
 
         uint8_t getDeviceID();
 
@@ -665,11 +702,27 @@ class BMI160Class {
         unsigned sensors_enabled;
         float accel_range;
         float gyro_range;
+        /* Per LSB, worked out when the range is set: g or deg/s as float,
+         * and in Q16.16, which is exact as the ranges are whole numbers */
+        float accel_scale;
+        float gyro_scale;
+        int32_t accel_scale_q16;
+        int32_t gyro_scale_q16;
 
     protected:
         virtual int serial_buffer_transfer(uint8_t *buf, unsigned tx_cnt, unsigned rx_cnt) = 0;
 
     private:
+        /* Shadow copy of the configuration registers, see beginConfig().
+         * Only what a transfer that succeeded read or wrote is valid. */
+        uint8_t reg_cache[BMI160_CACHE_SIZE];
+        uint64_t reg_valid;
+        uint64_t reg_dirty;
+        unsigned reg_hold;
+
+        static bool reg_cacheable(uint8_t reg);
+        void reg_load();
+        void reg_flush();
         uint8_t reg_read (uint8_t reg);
         void reg_write(uint8_t reg, uint8_t data);
         void reg_write_bits(uint8_t reg, uint8_t data, unsigned pos, unsigned len);
@@ -18,13 +18,18 @@
  */
 
 #include "CurieIMU.h"
-#include "ss_spi.h"
+#include "spi_async.h"
 #include "interrupt.h"
 
 #define CURIE_IMU_CHIP_ID 0xD1
 
 #define BMI160_GPIN_AON_PIN 4
 
+/* One FIFO burst, plus room for the sensortime frame behind the last one;
+ * the register address goes out from the first byte. Shared by readFIFO()
+ * and acquisition; readFIFO() does nothing while acquisition runs */
+static uint8_t fifo_buffer[BMI160_FIFO_SIZE + 1 + BMI160_FIFO_TIME_LEN];
+
 /******************************************************************************/
 
 /** Power on and prepare for general usage.
@@ -36,6 +41,7 @@
 bool CurieIMUClass::configure_imu(unsigned int sensors)
 {
     ss_spi_init(SPI_SENSING_1, 2000, SPI_BUSMODE_0, SPI_8_BIT, SPI_SE_1);
+    spi_async_init(SPI_SENSING_1, SPI_SE_1);
 
     /* Perform a dummy read from 0x7f to switch to spi interface */
     uint8_t dummy_reg = 0x7F;
@@ -66,7 +72,7 @@ bool CurieIMUClass::begin(unsigned int sensors)
 
 void CurieIMUClass::end()
 {
-    ss_spi_disable(SPI_SENSING_1);
+    spi_async_disable(SPI_SENSING_1);
 }
 
 bool CurieIMUClass::dataReady()
@@ -1604,18 +1610,6 @@ void CurieIMUClass::setStepDetectionMode(int mode)
     BMI160Class::setStepDetectionMode((BMI160StepMode)mode);
 }
 
-float CurieIMUClass::convertRaw(int16_t raw, float range_abs)
-{
-    float slope;
-    float val;
-
-    /* Input range will be -32768 to 32767
-     * Output range must be -range_abs to range_abs */
-    val = (float)raw;
-    slope = (range_abs * 2.0f) / BMI160_SENSOR_RANGE;
-    return -(range_abs) + slope * (val + BMI160_SENSOR_LOW);
-}
-
 void CurieIMUClass::readMotionSensor(int &ax, int &ay, int &az, int &gx,
                                      int &gy, int &gz)
 {
@@ -1638,12 +1632,12 @@ void CurieIMUClass::readMotionSensorScaled(float &ax, float &ay, float &az,
 
     getMotion6(&sax, &say, &saz, &sgx, &sgy, &sgz);
 
-    ax = convertRaw(sax, accel_range);
-    ay = convertRaw(say, accel_range);
-    az = convertRaw(saz, accel_range);
-    gx = convertRaw(sgx, gyro_range);
-    gy = convertRaw(sgy, gyro_range);
-    gz = convertRaw(sgz, gyro_range);
+    ax = accelScaled(sax);
+    ay = accelScaled(say);
+    az = accelScaled(saz);
+    gx = gyroScaled(sgx);
+    gy = gyroScaled(sgy);
+    gz = gyroScaled(sgz);
 }
 
 void CurieIMUClass::readAccelerometer(int &x, int &y, int &z)
@@ -1663,9 +1657,9 @@ void CurieIMUClass::readAccelerometerScaled(float &x, float &y, float &z)
 
     getAcceleration(&sx, &sy, &sz);
 
-    x = convertRaw(sx, accel_range);
-    y = convertRaw(sy, accel_range);
-    z = convertRaw(sz, accel_range);
+    x = accelScaled(sx);
+    y = accelScaled(sy);
+    z = accelScaled(sz);
 }
 
 void CurieIMUClass::readGyro(int &x, int &y, int &z)
@@ -1685,9 +1679,9 @@ void CurieIMUClass::readGyroScaled(float &x, float &y, float &z)
 
     getRotation(&sx, &sy, &sz);
 
-    x = convertRaw(sx, gyro_range);
-    y = convertRaw(sy, gyro_range);
-    z = convertRaw(sz, gyro_range);
+    x = gyroScaled(sx);
+    y = gyroScaled(sy);
+    z = gyroScaled(sz);
 }
 
 int CurieIMUClass::readAccelerometer(int axis)
@@ -1717,7 +1711,7 @@ float CurieIMUClass::readAccelerometerScaled(int axis)
         return 0;
     }
 
-    return convertRaw(raw, accel_range);
+    return accelScaled(raw);
 }
 
 int CurieIMUClass::readGyro(int axis)
@@ -1747,7 +1741,7 @@ float CurieIMUClass::readGyroScaled(int axis)
         return 0;
     }
 
-    return convertRaw(raw, gyro_range);
+    return gyroScaled(raw);
 }
 
 int CurieIMUClass::readTemperature()
@@ -1755,6 +1749,195 @@ int CurieIMUClass::readTemperature()
     return getTemperature();
 }
 
+/** Convert 'count' raw accelerometer readings to g, with the scale worked
+ *  out by setAccelerometerRange(); one multiply per reading.
+ */
+void CurieIMUClass::convertAccelerometer(const int16_t *raw, float *out,
+                                         int count)
+{
+    float scale = accel_scale;
+
+    while (count-- > 0)
+        *out++ = *raw++ * scale;
+}
+
+/** Convert 'count' raw gyro readings to degrees/second.
+ *  @see convertAccelerometer()
+ */
+void CurieIMUClass::convertGyro(const int16_t *raw, float *out, int count)
+{
+    float scale = gyro_scale;
+
+    while (count-- > 0)
+        *out++ = *raw++ * scale;
+}
+
+/** Convert 'count' raw accelerometer readings to g in Q16.16 fixed point
+ *  (65536 is 1g), without any floating point. The result is exact: a
+ *  reading is a Q15 fraction of the range, and the ranges are whole
+ *  numbers.
+ */
+void CurieIMUClass::convertAccelerometerQ16(const int16_t *raw, int32_t *out,
+                                            int count)
+{
+    int32_t scale = accel_scale_q16;
+
+    while (count-- > 0)
+        *out++ = *raw++ * scale;
+}
+
+/** Convert 'count' raw gyro readings to degrees/second in Q16.16.
+ *  @see convertAccelerometerQ16()
+ */
+void CurieIMUClass::convertGyroQ16(const int16_t *raw, int32_t *out, int count)
+{
+    int32_t scale = gyro_scale_q16;
+
+    while (count-- > 0)
+        *out++ = *raw++ * scale;
+}
+
+static inline int16_t fifo_word(const uint8_t *p)
+{
+    return (((int16_t)p[1]) << 8) | p[0];
+}
+
+void CurieIMUClass::reset_block(CurieIMUFIFOBatch& batch)
+{
+    batch.count = 0;
+    batch.skipped = 0;
+    batch.hasSensorTime = false;
+    batch.sensorTimeIndex = 0;
+    batch.corrupt = false;
+}
+
+/* Add the frames in 'data' to 'batch' until it holds 'max' samples;
+ * returns the bytes consumed */
+int CurieIMUClass::append_fifo(const uint8_t *data, int length,
+                               CurieIMUFIFOBatch& batch, int max)
+{
+    int pos = 0;
+
+    if (max > CURIE_IMU_FIFO_SAMPLES)
+        max = CURIE_IMU_FIFO_SAMPLES;
+
+    while (pos < length) {
+        uint8_t header = data[pos];
+        const uint8_t *p = &data[pos + 1];
+        int size = 1;
+
+        if (header == BMI160_FIFO_DATA_INVALID)
+            break;
+        if ((header & BMI160_FIFO_HEADER_MODE_MASK) == BMI160_FIFO_HEADER_REGULAR) {
+            int i = batch.count;
+
+            if (header & BMI160_FIFO_HEADER_MAG)
+                size += BMI160_FIFO_MAG_LEN;
+            if (header & BMI160_FIFO_HEADER_GYR)
+                size += BMI160_FIFO_GYR_LEN;
+            if (header & BMI160_FIFO_HEADER_ACC)
+                size += BMI160_FIFO_ACC_LEN;
+            if (pos + size > length || i >= max)
+                break;
+
+            /* Magnetometer, gyro, accelerometer, in that order */
+            if (header & BMI160_FIFO_HEADER_MAG)
+                p += BMI160_FIFO_MAG_LEN;
+            batch.sensors[i] = 0;
+            if (header & BMI160_FIFO_HEADER_GYR) {
+                batch.gx[i] = fifo_word(p);
+                batch.gy[i] = fifo_word(p + 2);
+                batch.gz[i] = fifo_word(p + 4);
+                batch.sensors[i] |= CURIE_IMU_SAMPLE_GYRO;
+                p += BMI160_FIFO_GYR_LEN;
+            }
+            if (header & BMI160_FIFO_HEADER_ACC) {
+                batch.ax[i] = fifo_word(p);
+                batch.ay[i] = fifo_word(p + 2);
+                batch.az[i] = fifo_word(p + 4);
+                batch.sensors[i] |= CURIE_IMU_SAMPLE_ACCEL;
+            }
+            batch.count++;
+        } else if (header == BMI160_FIFO_HEADER_SKIP) {
+            size += 1;
+            if (pos + size > length)
+                break;
+            batch.skipped += p[0];
+        } else if (header == BMI160_FIFO_HEADER_TIME) {
+            size += BMI160_FIFO_TIME_LEN;
+            if (pos + size > length)
+                break;
+            batch.sensorTime = p[0] | ((uint32_t)p[1] << 8) |
+                               ((uint32_t)p[2] << 16);
+            batch.hasSensorTime = true;
+            batch.sensorTimeIndex = batch.count + batch.skipped;
+        } else if (header == BMI160_FIFO_HEADER_CONFIG) {
+            size += 1;
+            if (pos + size > length)
+                break;
+        } else {
+            batch.corrupt = true;
+            break;
+        }
+        pos += size;
+    }
+
+    return pos;
+}
+
+/** Parse header-mode FIFO frames into 'batch', up to 'max' samples.
+ *  Regular frames become samples, skip frames add to batch.skipped and a
+ *  sensortime frame sets batch.sensorTime. Parsing stops at the first
+ *  frame not wholly in 'data', at an over-read (header 0x80) or at an
+ *  unknown header, which also sets batch.corrupt. Does no I/O, so it runs
+ *  as well on a recorded FIFO dump.
+ *  @return number of samples
+ */
+int CurieIMUClass::parseFIFO(const uint8_t *data, int length,
+                             CurieIMUFIFOBatch& batch, int max)
+{
+    reset_block(batch);
+    append_fifo(data, length, batch, max);
+    return batch.count;
+}
+
+/** Drain the FIFO in one SPI burst and parse it into 'batch'.
+ *  The FIFO must be in header mode (setFIFOHeaderModeEnabled()), with the
+ *  accelerometer and/or gyro feeding it; with setFIFOTimeEnabled() the
+ *  sensortime of the last frame comes along. No more is read than 'max'
+ *  samples can take; a frame cut short by the burst is sent again by the
+ *  BMI160, so frames left behind are returned by the next call.
+ *  batch.skipped reports frames lost to a FIFO overrun.
+ *  Not while startAcquisition() runs, which drains the FIFO itself: the
+ *  batch is then left empty.
+ *  @return number of samples, 0 if the FIFO could not be read
+ */
+int CurieIMUClass::readFIFO(CurieIMUFIFOBatch& batch, int max)
+{
+    unsigned length;
+
+    if (_acq_blocks) {
+        reset_block(batch);
+        return 0;
+    }
+
+    if (max > CURIE_IMU_FIFO_SAMPLES)
+        max = CURIE_IMU_FIFO_SAMPLES;
+    length = getFIFOCount() & BMI160_FIFO_LENGTH_MASK;
+    if (length > (unsigned)max * BMI160_FIFO_FRAME_MAX)
+        length = max * BMI160_FIFO_FRAME_MAX;
+    if (length > BMI160_FIFO_SIZE)
+        length = BMI160_FIFO_SIZE;
+    /* The sensortime frame follows once the FIFO is read empty */
+    length += 1 + BMI160_FIFO_TIME_LEN;
+
+    if (getFIFOBytes(fifo_buffer, length) != 0) {
+        reset_block(batch);
+        return 0;
+    }
+    return parseFIFO(fifo_buffer, length, batch, max);
+}
+
 bool CurieIMUClass::shockDetected(int axis, int direction)
 {
     if (direction == POSITIVE) {
@@ -1832,14 +2015,23 @@ bool CurieIMUClass::stepsDetected()
 /** Provides a serial buffer transfer implementation for the BMI160 base class
  *  to use for accessing device registers.  This implementation uses the SPI
  *  bus on the Intel Curie module to communicate with the BMI160.
+ *  From an interrupt handler, or with interrupts disabled, while acquisition
+ *  transfers are on the bus, nothing is transferred: reads come back as 0
+ *  rather than the register address, and DRV_RC_CONTROLLER_IN_USE is
+ *  returned.
  */
 int CurieIMUClass::serial_buffer_transfer(uint8_t *buf, unsigned tx_cnt,
                                           unsigned rx_cnt)
 {
+    int ret;
+
     if (rx_cnt) /* For read transfers, assume 1st byte contains register address */
         buf[0] |= (1 << BMI160_SPI_READ_BIT);
 
-    return ss_spi_xfer(SPI_SENSING_1, buf, tx_cnt, rx_cnt);
+    ret = spi_async_xfer(SPI_SENSING_1, buf, tx_cnt, rx_cnt);
+    if (ret != DRV_RC_OK)
+        memset(buf, 0, rx_cnt);
+    return ret;
 }
 
 /** Interrupt handler for interrupts from PIN1 on the BMI160
@@ -1850,7 +2042,9 @@ int CurieIMUClass::serial_buffer_transfer(uint8_t *buf, unsigned tx_cnt,
 void bmi160_pin1_isr(void)
 {
     soc_gpio_mask_interrupt(SOC_GPIO_AON, BMI160_GPIN_AON_PIN);
-    if (CurieIMU._user_callback)
+    if (CurieIMU._acq_blocks)
+        CurieIMU.acq_kick();
+    else if (CurieIMU._user_callback)
         CurieIMU._user_callback();
     soc_gpio_unmask_interrupt(SOC_GPIO_AON, BMI160_GPIN_AON_PIN);
 }
@@ -1860,9 +2054,14 @@ void bmi160_pin1_isr(void)
  */
 void CurieIMUClass::attachInterrupt(void (*callback)(void))
 {
-    gpio_cfg_data_t cfg;
-
     _user_callback = callback;
+    attach_pin1(BMI160_LATCH_MODE_10_MS); // 10ms pulse
+}
+
+/* Route PIN1 to bmi160_pin1_isr() and enable it on the BMI160 side */
+void CurieIMUClass::attach_pin1(int latch)
+{
+    gpio_cfg_data_t cfg;
 
     memset(&cfg, 0, sizeof(gpio_cfg_data_t));
     cfg.gpio_type = GPIO_INTERRUPT;
@@ -1872,10 +2071,12 @@ void CurieIMUClass::attachInterrupt(void (*callback)(void))
     cfg.gpio_cb = bmi160_pin1_isr;
     soc_gpio_set_config(SOC_GPIO_AON, BMI160_GPIN_AON_PIN, &cfg);
 
+    beginConfig();
     setInterruptMode(1);                        // Active-Low
     setInterruptDrive(0);                       // Push-Pull
-    setInterruptLatch(BMI160_LATCH_MODE_10_MS); // 10ms pulse
+    setInterruptLatch(latch);
     setIntEnabled(true);
+    commit();
 }
 
 /** Disables PIN1 interrupts from the BMI160 module.
@@ -1887,5 +2088,251 @@ void CurieIMUClass::detachInterrupt(void)
     soc_gpio_deconfig(SOC_GPIO_AON, BMI160_GPIN_AON_PIN);
 }
 
+/** Start watermark driven acquisition into the two 'blocks', which stay
+ *  in use until stopAcquisition(). The FIFO is set up in header mode with
+ *  the accelerometer, gyro and sensortime feeding it, and each FIFO
+ *  watermark interrupt on PIN1 drains it with queued SPI transfers,
+ *  appending to the block being filled. A block holding 'blockSamples'
+ *  samples is handed to loop() through blockReady()/getBlock() and the
+ *  other one fills meanwhile; it comes back into use by releaseBlock().
+ *  PIN1 is taken over: a callback from attachInterrupt() is not called
+ *  while acquisition runs.
+ *  @return false if the arguments are invalid
+ */
+bool CurieIMUClass::startAcquisition(CurieIMUFIFOBatch blocks[2],
+                                     int blockSamples)
+{
+    int watermark;
+
+    if (blocks == NULL || blockSamples < 1)
+        return false;
+    if (blockSamples > CURIE_IMU_FIFO_SAMPLES)
+        blockSamples = CURIE_IMU_FIFO_SAMPLES;
+    stopAcquisition();
+
+    reset_block(blocks[0]);
+    reset_block(blocks[1]);
+    _acq_block_samples = blockSamples;
+    _acq_fill = 0;
+    _acq_read = 0;
+    _acq_ready[0] = false;
+    _acq_ready[1] = false;
+    _acq_pending = false;
+    _acq_overruns = 0;
+
+    /* Drain about a block at a time, but early enough that the FIFO has
+     * half its room left while the drain runs */
+    watermark = blockSamples * BMI160_FIFO_FRAME_MAX;
+    if (watermark > BMI160_FIFO_SIZE / 2)
+        watermark = BMI160_FIFO_SIZE / 2;
+    beginConfig();
+    setFIFOHeaderModeEnabled(true);
+    setFIFOTimeEnabled(true);
+    setAccelFIFOEnabled(true);
+    setGyroFIFOEnabled(true);
+    setFIFOWatermark(watermark);
+    commit();
+    resetFIFO();
+
+    _acq_blocks = blocks;
+    _acq_last_drain = millis();
+    /* Non-latched, so that each drain below the watermark re-arms the
+     * edge */
+    attach_pin1(BMI160_LATCH_MODE_NONE);
+    setIntFIFOWatermarkEnabled(true);
+    return true;
+}
+
+/** Stop acquisition. Blocks not yet released keep their samples, and no
+ *  more go into them once this returns. A drain in progress is waited for,
+ *  except from an interrupt handler or with interrupts disabled, where it
+ *  could not finish; it then completes later without touching the blocks.
+ */
+void CurieIMUClass::stopAcquisition(void)
+{
+    uint32_t saved;
+
+    if (!_acq_blocks)
+        return;
+
+    setIntFIFOWatermarkEnabled(false);
+    detachInterrupt();
+    saved = interrupt_lock();
+    _acq_blocks = NULL;
+    _acq_pending = false;
+    interrupt_unlock(saved);
+    while (_acq_draining && spi_async_can_wait())
+        ;
+}
+
+/** With acquisition running, whether a full block is waiting in
+ *  getBlock(). Also drains the FIFO if no watermark interrupt came for
+ *  CURIE_IMU_ACQ_WATCHDOG_MS, so a missed edge cannot stall acquisition.
+ */
+bool CurieIMUClass::blockReady(void)
+{
+    if (!_acq_blocks)
+        return false;
+    if (!_acq_draining &&
+        millis() - _acq_last_drain > CURIE_IMU_ACQ_WATCHDOG_MS)
+        acq_kick();
+    return _acq_ready[_acq_read];
+}
+
+/** The oldest full block, or NULL if none is ready. It belongs to the
+ *  caller until releaseBlock().
+ */
+CurieIMUFIFOBatch *CurieIMUClass::getBlock(void)
+{
+    if (!_acq_blocks || !_acq_ready[_acq_read])
+        return NULL;
+    return &_acq_blocks[_acq_read];
+}
+
+/** Give the block from getBlock() back for filling.
+ */
+void CurieIMUClass::releaseBlock(void)
+{
+    if (!_acq_blocks || !_acq_ready[_acq_read])
+        return;
+    reset_block(_acq_blocks[_acq_read]);
+    _acq_ready[_acq_read] = false;
+    _acq_read ^= 1;
+}
+
+/** Number of drains that found both blocks full, because loop() did not
+ *  release them in time; the samples of such a drain are lost.
+ */
+unsigned CurieIMUClass::getBlockOverruns(void)
+{
+    return _acq_overruns;
+}
+
+/* Start draining the FIFO: its length first, then that many bytes. If a
+ * drain is running already, another one follows it. */
+void CurieIMUClass::acq_kick(void)
+{
+    uint32_t saved = interrupt_lock();
+
+    if (_acq_draining) {
+        _acq_pending = true;
+        interrupt_unlock(saved);
+        return;
+    }
+    _acq_draining = true;
+    _acq_pending = false;
+    _acq_length[0] = BMI160_RA_FIFO_LENGTH_0 | (1 << BMI160_SPI_READ_BIT);
+    _acq_xfer.buf = _acq_length;
+    _acq_xfer.tx_cnt = 1;
+    _acq_xfer.rx_cnt = 2;
+    _acq_xfer.done = acq_length_done;
+    _acq_xfer.arg = this;
+    if (spi_async_submit(SPI_SENSING_1, &_acq_xfer) != DRV_RC_OK)
+        _acq_draining = false;
+    interrupt_unlock(saved);
+}
+
+void CurieIMUClass::acq_drained(void)
+{
+    _acq_last_drain = millis();
+    _acq_draining = false;
+    if (_acq_pending && _acq_blocks)
+        acq_kick();
+}
+
+/* Whether 'data' holds a complete regular frame, a sample append_fifo()
+ * would take */
+bool CurieIMUClass::fifo_has_sample(const uint8_t *data, int length)
+{
+    int pos = 0;
+
+    while (pos < length) {
+        uint8_t header = data[pos];
+        int size = 1;
+
+        if (header == BMI160_FIFO_DATA_INVALID)
+            return false;
+        if ((header & BMI160_FIFO_HEADER_MODE_MASK) == BMI160_FIFO_HEADER_REGULAR) {
+            if (header & BMI160_FIFO_HEADER_MAG)
+                size += BMI160_FIFO_MAG_LEN;
+            if (header & BMI160_FIFO_HEADER_GYR)
+                size += BMI160_FIFO_GYR_LEN;
+            if (header & BMI160_FIFO_HEADER_ACC)
+                size += BMI160_FIFO_ACC_LEN;
+            return pos + size <= length;
+        } else if (header == BMI160_FIFO_HEADER_SKIP ||
+                   header == BMI160_FIFO_HEADER_CONFIG) {
+            size += 1;
+        } else if (header == BMI160_FIFO_HEADER_TIME) {
+            size += BMI160_FIFO_TIME_LEN;
+        } else {
+            return false;
+        }
+        pos += size;
+    }
+    return false;
+}
+
+/* Append a drain to the block being filled, moving on to the other one
+ * when it is full */
+void CurieIMUClass::acq_store(const uint8_t *data, int length)
+{
+    int pos = 0;
+
+    for (;;) {
+        CurieIMUFIFOBatch *block = &_acq_blocks[_acq_fill];
+
+        if (pos >= length || data[pos] == BMI160_FIFO_DATA_INVALID)
+            return;
+        if (_acq_ready[_acq_fill]) {
+            /* loop() still has it; what is left only counts as lost if
+             * it holds a sample, not just a frame the BMI160 sends again
+             * or the sensortime */
+            if (fifo_has_sample(data + pos, length - pos))
+                _acq_overruns++;
+            return;
+        }
+        pos += append_fifo(data + pos, length - pos, *block,
+                           _acq_block_samples);
+        if (block->count < _acq_block_samples)
+            return;
+        _acq_ready[_acq_fill] = true;
+        _acq_fill ^= 1;
+    }
+}
+
+void CurieIMUClass::acq_length_done(spi_xfer_t *xfer)
+{
+    CurieIMUClass *imu = (CurieIMUClass *)xfer->arg;
+    unsigned length;
+
+    if (xfer->status == DRV_RC_OK && imu->_acq_blocks) {
+        length = (imu->_acq_length[0] | (imu->_acq_length[1] << 8)) &
+                 BMI160_FIFO_LENGTH_MASK;
+        if (length > BMI160_FIFO_SIZE)
+            length = BMI160_FIFO_SIZE;
+        if (length) {
+            /* Room for the sensortime frame too */
+            fifo_buffer[0] = BMI160_RA_FIFO_DATA | (1 << BMI160_SPI_READ_BIT);
+            xfer->buf = fifo_buffer;
+            xfer->tx_cnt = 1;
+            xfer->rx_cnt = length + 1 + BMI160_FIFO_TIME_LEN;
+            xfer->done = acq_data_done;
+            if (spi_async_submit(SPI_SENSING_1, xfer) == DRV_RC_OK)
+                return;
+        }
+    }
+    imu->acq_drained();
+}
+
+void CurieIMUClass::acq_data_done(spi_xfer_t *xfer)
+{
+    CurieIMUClass *imu = (CurieIMUClass *)xfer->arg;
+
+    if (xfer->status == DRV_RC_OK && imu->_acq_blocks)
+        imu->acq_store(fifo_buffer, xfer->rx_cnt);
+    imu->acq_drained();
+}
+
 /* Pre-instantiated Object for this class */
 CurieIMUClass CurieIMU;
@@ -23,6 +23,7 @@
 #define _CURIEIMU_H_
 
 #include "BMI160.h"
+#include "spi_async.h"
 
 /**
  * axis options
@@ -80,6 +81,53 @@ typedef enum {
     CURIE_IMU_STEP_MODE_UNKNOWN = BMI160_STEP_MODE_UNKNOWN
 } CurieIMUStepMode;
 
+/**
+ * Capacity of a CurieIMUFIFOBatch, in samples. A full FIFO holds 78
+ * accelerometer + gyro frames.
+ * @see readFIFO()
+ */
+#ifndef CURIE_IMU_FIFO_SAMPLES
+#define CURIE_IMU_FIFO_SAMPLES 80
+#endif
+
+/**
+ * Sensors present in a CurieIMUFIFOBatch sample
+ */
+#define CURIE_IMU_SAMPLE_ACCEL 0x01
+#define CURIE_IMU_SAMPLE_GYRO  0x02
+
+/**
+ * Samples parsed from header-mode FIFO frames, one index per frame, with
+ * raw values as from readMotionSensor(). Entries of a sensor not in
+ * sensors[i] are left as they were.
+ * @see readFIFO()
+ * @see parseFIFO()
+ */
+struct CurieIMUFIFOBatch {
+    int16_t ax[CURIE_IMU_FIFO_SAMPLES];
+    int16_t ay[CURIE_IMU_FIFO_SAMPLES];
+    int16_t az[CURIE_IMU_FIFO_SAMPLES];
+    int16_t gx[CURIE_IMU_FIFO_SAMPLES];
+    int16_t gy[CURIE_IMU_FIFO_SAMPLES];
+    int16_t gz[CURIE_IMU_FIFO_SAMPLES];
+    uint8_t sensors[CURIE_IMU_FIFO_SAMPLES];
+    int count;              /* samples filled in */
+    unsigned skipped;       /* frames the FIFO dropped while full */
+    bool hasSensorTime;     /* sensorTime is valid */
+    uint32_t sensorTime;    /* 24 bits, 39.0625us units, of the last frame
+                               before the sensortime frame */
+    unsigned sensorTimeIndex; /* samples + skipped frames before it; the
+                               rest of the batch came later */
+    bool corrupt;           /* parsing stopped at an unknown header */
+};
+
+/**
+ * With acquisition running, blockReady() drains the FIFO itself after
+ * this long without a watermark interrupt, in case one was missed
+ * @see startAcquisition()
+ */
+#define CURIE_IMU_ACQ_WATCHDOG_MS 100
+
 /* Note that this CurieIMUClass class inherits methods from the BMI160Class which
  * is defined in BMI160.h.  BMI160Class provides methods for configuring and
  * accessing features of the BMI160 IMU device.  This CurieIMUClass extends that
@@ -202,6 +250,24 @@ class CurieIMUClass : public BMI160Class {
         float readGyroScaled(int axis);
         int readTemperature();
 
+        void convertAccelerometer(const int16_t *raw, float *out, int count);
+        void convertGyro(const int16_t *raw, float *out, int count);
+        void convertAccelerometerQ16(const int16_t *raw, int32_t *out, int count);
+        void convertGyroQ16(const int16_t *raw, int32_t *out, int count);
+
+        int readFIFO(CurieIMUFIFOBatch& batch, int max = CURIE_IMU_FIFO_SAMPLES);
+        static int parseFIFO(const uint8_t *data, int length,
+                             CurieIMUFIFOBatch& batch,
+                             int max = CURIE_IMU_FIFO_SAMPLES);
+
+        bool startAcquisition(CurieIMUFIFOBatch blocks[2],
+                              int blockSamples = CURIE_IMU_FIFO_SAMPLES);
+        void stopAcquisition(void);
+        bool blockReady(void);
+        CurieIMUFIFOBatch *getBlock(void);
+        void releaseBlock(void);
+        unsigned getBlockOverruns(void);
+
         bool shockDetected(int axis, int direction);
         bool motionDetected(int axis, int direction);
         bool tapDetected(int axis, int direction);
@@ -213,6 +279,16 @@ class CurieIMUClass : public BMI160Class {
     private:
         bool configure_imu(unsigned int sensors);
         int serial_buffer_transfer(uint8_t *buf, unsigned tx_cnt, unsigned rx_cnt);
+        void attach_pin1(int latch);
+        static int append_fifo(const uint8_t *data, int length,
+                               CurieIMUFIFOBatch& batch, int max);
+        static bool fifo_has_sample(const uint8_t *data, int length);
+        static void reset_block(CurieIMUFIFOBatch& batch);
+        void acq_kick(void);
+        void acq_drained(void);
+        void acq_store(const uint8_t *data, int length);
+        static void acq_length_done(spi_xfer_t *xfer);
+        static void acq_data_done(spi_xfer_t *xfer);
 
         float getFreefallDetectionThreshold();
         void setFreefallDetectionThreshold(float threshold);
@@ -240,11 +316,26 @@ class CurieIMUClass : public BMI160Class {
         int getDoubleTapDetectionDuration();
         void setDoubleTapDetectionDuration(int duration);
 
-        float convertRaw(int16_t raw, float range_abs);
+        inline float accelScaled(int16_t raw) { return raw * accel_scale; }
+        inline float gyroScaled(int16_t raw) { return raw * gyro_scale; }
 
         void enableInterrupt(int feature, bool enabled);
 
         void (*_user_callback)(void);
+
+        /* Watermark driven acquisition; blocks fill in turn from the SPI
+         * interrupts and go back to filling once released */
+        CurieIMUFIFOBatch *_acq_blocks;
+        int _acq_block_samples;
+        uint8_t _acq_fill;
+        uint8_t _acq_read;
+        volatile bool _acq_ready[2];
+        volatile bool _acq_draining;
+        volatile bool _acq_pending;
+        volatile uint32_t _acq_last_drain;
+        volatile unsigned _acq_overruns;
+        spi_xfer_t _acq_xfer;
+        uint8_t _acq_length[2];
 };
 
 extern CurieIMUClass CurieIMU;
@@ -0,0 +1,359 @@
+/*
+ * Orientation estimation from CurieIMU FIFO batches.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "CurieIMUFusion.h"
+#include <math.h>
+
+/* 1/sqrt(x) by the integer estimate and two Newton steps, good to ~5e-6;
+ * far cheaper than sqrtf() and a division in soft float */
+static inline float inv_sqrt(float x)
+{
+    union {
+        float f;
+        int32_t i;
+    } u;
+    float half = 0.5f * x;
+
+    u.f = x;
+    u.i = 0x5f375a86 - (u.i >> 1);
+    u.f = u.f * (1.5f - half * u.f * u.f);
+    u.f = u.f * (1.5f - half * u.f * u.f);
+    return u.f;
+}
+
+CurieIMUFusion::CurieIMUFusion(CurieIMUClass& imu) :
+    _imu(imu),
+    _filter(CURIE_IMU_FUSION_MADGWICK),
+    _beta(CURIE_IMU_FUSION_BETA),
+    _two_kp(CURIE_IMU_FUSION_2KP),
+    _two_ki(CURIE_IMU_FUSION_2KI)
+{
+    begin(100.0f, CURIE_IMU_FUSION_MADGWICK);
+}
+
+/** Reset the attitude and set the filter.
+ *  'sampleRate' is the nominal FIFO output rate in Hz, as set with
+ *  setGyroRate(); it is the time step until sensortime frames measure
+ *  the real one, and the reference that rejects bad measurements.
+ *  The attitude is levelled on the first accelerometer sample.
+ *  @param filter CURIE_IMU_FUSION_MADGWICK or CURIE_IMU_FUSION_MAHONY
+ */
+void CurieIMUFusion::begin(float sampleRate, int filter)
+{
+    _filter = filter;
+    _q0 = 1.0f;
+    _q1 = _q2 = _q3 = 0.0f;
+    _ibx = _iby = _ibz = 0.0f;
+    _nominal_dt = 1.0f / sampleRate;
+    _dt = _nominal_dt;
+    _pending_dt = 0.0f;
+    _frames = 0;
+    _have_time = false;
+    _aligned = false;
+    _last_time = 0;
+}
+
+/** Set the Madgwick gradient step (default CURIE_IMU_FUSION_BETA).
+ *  Higher follows the accelerometer faster, at the cost of more noise.
+ */
+void CurieIMUFusion::setBeta(float beta)
+{
+    _beta = beta;
+}
+
+/** Set the Mahony proportional and integral gains, both doubled
+ *  (defaults CURIE_IMU_FUSION_2KP and CURIE_IMU_FUSION_2KI). With
+ *  twoKi above zero the filter also learns the gyro bias.
+ */
+void CurieIMUFusion::setMahonyGains(float twoKp, float twoKi)
+{
+    _two_kp = twoKp;
+    _two_ki = twoKi;
+    if (twoKi <= 0.0f)
+        _ibx = _iby = _ibz = 0.0f;
+}
+
+/** Feed the samples of a batch, as from CurieIMU.readFIFO() or
+ *  CurieIMU.getBlock(), in FIFO order.
+ *  Each batch carrying a sensortime (setFIFOTimeEnabled()) times every
+ *  frame since the previous one up to batch.sensorTimeIndex, frames the
+ *  FIFO skipped included; the sample period follows that measurement
+ *  through a 1/8 low-pass, and a measurement off by more than a factor
+ *  of two from the nominal rate is ignored. Frames with accelerometer data only add their time to
+ *  the next gyro sample.
+ *  @return number of samples that updated the attitude
+ */
+int CurieIMUFusion::update(const CurieIMUFIFOBatch& batch)
+{
+    float gscale = _imu.gyro_scale * (float)DEG_TO_RAD;
+    float ax, ay, az;
+    int updates = 0;
+    int i;
+
+    if (!batch.hasSensorTime) {
+        _frames += batch.count + batch.skipped;
+    } else {
+        /* An acquisition block can go on past its sensortime with the
+         * start of the next drain; those frames belong to the next
+         * interval */
+        _frames += batch.sensorTimeIndex;
+        if (_have_time && _frames > 0) {
+            uint32_t ticks = (batch.sensorTime - _last_time) &
+                             CURIE_IMU_SENSORTIME_MASK;
+            float dt = ticks * (CURIE_IMU_SENSORTIME_US * 1e-6f) / _frames;
+
+            if (dt > 0.5f * _nominal_dt && dt < 2.0f * _nominal_dt)
+                _dt += (dt - _dt) * 0.125f;
+        }
+        _last_time = batch.sensorTime;
+        _have_time = true;
+        _frames = batch.count + batch.skipped - batch.sensorTimeIndex;
+    }
+
+    /* the skipped frames were lost from the end of the FIFO */
+    _pending_dt += batch.skipped * _dt;
+
+    for (i = 0; i < batch.count; i++) {
+        uint8_t sensors = batch.sensors[i];
+
+        if (sensors & CURIE_IMU_SAMPLE_ACCEL) {
+            ax = batch.ax[i];
+            ay = batch.ay[i];
+            az = batch.az[i];
+            if (!_aligned)
+                align(ax, ay, az);
+        } else {
+            ax = ay = az = 0.0f;
+        }
+
+        _pending_dt += _dt;
+        if (!(sensors & CURIE_IMU_SAMPLE_GYRO) || !_aligned)
+            continue;
+
+        /* the accelerometer is normalized, so its raw units will do */
+        update(batch.gx[i] * gscale, batch.gy[i] * gscale,
+               batch.gz[i] * gscale, ax, ay, az, _pending_dt);
+        _pending_dt = 0.0f;
+        updates++;
+    }
+
+    return updates;
+}
+
+/** Advance the attitude by one sample.
+ *  Gyro rates are in radians/second and 'dt' in seconds; the
+ *  accelerometer may be in any unit, and all zero leaves out the
+ *  correction (gyro integration only).
+ */
+void CurieIMUFusion::update(float gx, float gy, float gz,
+                            float ax, float ay, float az, float dt)
+{
+    if (_filter == CURIE_IMU_FUSION_MAHONY)
+        mahony(gx, gy, gz, ax, ay, az, dt);
+    else
+        madgwick(gx, gy, gz, ax, ay, az, dt);
+}
+
+/** Get the attitude quaternion, sensor frame to earth frame */
+void CurieIMUFusion::getQuaternion(float& w, float& x, float& y, float& z)
+{
+    w = _q0;
+    x = _q1;
+    y = _q2;
+    z = _q3;
+}
+
+/** Get the rotation about X, in degrees (-180 to 180) */
+float CurieIMUFusion::getRoll()
+{
+    return atan2f(_q0 * _q1 + _q2 * _q3,
+                  0.5f - _q1 * _q1 - _q2 * _q2) * (float)RAD_TO_DEG;
+}
+
+/** Get the rotation about Y, in degrees (-90 to 90) */
+float CurieIMUFusion::getPitch()
+{
+    float s = -2.0f * (_q1 * _q3 - _q0 * _q2);
+
+    if (s > 1.0f)
+        s = 1.0f;
+    else if (s < -1.0f)
+        s = -1.0f;
+    return asinf(s) * (float)RAD_TO_DEG;
+}
+
+/** Get the rotation about Z, in degrees (-180 to 180). With no
+ *  magnetometer this is relative to the heading at begin() and drifts
+ *  with the gyro bias.
+ */
+float CurieIMUFusion::getYaw()
+{
+    return atan2f(_q1 * _q2 + _q0 * _q3,
+                  0.5f - _q2 * _q2 - _q3 * _q3) * (float)RAD_TO_DEG;
+}
+
+/** Get the sample period in use, in seconds, as measured from sensortime
+ *  or the nominal one given to begin()
+ */
+float CurieIMUFusion::getSamplePeriod()
+{
+    return _dt;
+}
+
+/* level the attitude on gravity, yaw zero */
+void CurieIMUFusion::align(float ax, float ay, float az)
+{
+    float roll, pitch, cr, sr, cp, sp;
+
+    if (ax == 0.0f && ay == 0.0f && az == 0.0f)
+        return;
+
+    roll = atan2f(ay, az) * 0.5f;
+    pitch = atan2f(-ax, sqrtf(ay * ay + az * az)) * 0.5f;
+    cr = cosf(roll);
+    sr = sinf(roll);
+    cp = cosf(pitch);
+    sp = sinf(pitch);
+
+    _q0 = cr * cp;
+    _q1 = sr * cp;
+    _q2 = cr * sp;
+    _q3 = -sr * sp;
+    _aligned = true;
+}
+
+void CurieIMUFusion::normalize()
+{
+    float n = inv_sqrt(_q0 * _q0 + _q1 * _q1 + _q2 * _q2 + _q3 * _q3);
+
+    _q0 *= n;
+    _q1 *= n;
+    _q2 *= n;
+    _q3 *= n;
+}
+
+/* Madgwick's IMU gradient descent filter */
+void CurieIMUFusion::madgwick(float gx, float gy, float gz,
+                              float ax, float ay, float az, float dt)
+{
+    float q0 = _q0, q1 = _q1, q2 = _q2, q3 = _q3;
+    float qd0, qd1, qd2, qd3;
+
+    qd0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+    qd1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+    qd2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+    qd3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+    if (!(ax == 0.0f && ay == 0.0f && az == 0.0f)) {
+        float n, s0, s1, s2, s3;
+        float _2q0, _2q1, _2q2, _2q3, _4q0, _4q1, _4q2, _8q1, _8q2;
+        float q0q0, q1q1, q2q2, q3q3;
+
+        n = inv_sqrt(ax * ax + ay * ay + az * az);
+        ax *= n;
+        ay *= n;
+        az *= n;
+
+        _2q0 = 2.0f * q0;
+        _2q1 = 2.0f * q1;
+        _2q2 = 2.0f * q2;
+        _2q3 = 2.0f * q3;
+        _4q0 = 4.0f * q0;
+        _4q1 = 4.0f * q1;
+        _4q2 = 4.0f * q2;
+        _8q1 = 8.0f * q1;
+        _8q2 = 8.0f * q2;
+        q0q0 = q0 * q0;
+        q1q1 = q1 * q1;
+        q2q2 = q2 * q2;
+        q3q3 = q3 * q3;
+
+        s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+        s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 +
+             _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+        s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 +
+             _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+        s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+        n = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+        if (n > 0.0f) {
+            n = _beta * inv_sqrt(n);
+            qd0 -= n * s0;
+            qd1 -= n * s1;
+            qd2 -= n * s2;
+            qd3 -= n * s3;
+        }
+    }
+
+    _q0 = q0 + qd0 * dt;
+    _q1 = q1 + qd1 * dt;
+    _q2 = q2 + qd2 * dt;
+    _q3 = q3 + qd3 * dt;
+    normalize();
+}
+
+/* Mahony's complementary filter, with optional gyro bias integration */
+void CurieIMUFusion::mahony(float gx, float gy, float gz,
+                            float ax, float ay, float az, float dt)
+{
+    float q0 = _q0, q1 = _q1, q2 = _q2, q3 = _q3;
+
+    if (!(ax == 0.0f && ay == 0.0f && az == 0.0f)) {
+        float n, vx, vy, vz, ex, ey, ez;
+
+        n = inv_sqrt(ax * ax + ay * ay + az * az);
+        ax *= n;
+        ay *= n;
+        az *= n;
+
+        /* half the estimated gravity direction */
+        vx = q1 * q3 - q0 * q2;
+        vy = q0 * q1 + q2 * q3;
+        vz = q0 * q0 - 0.5f + q3 * q3;
+
+        /* half the error, measured x estimated */
+        ex = ay * vz - az * vy;
+        ey = az * vx - ax * vz;
+        ez = ax * vy - ay * vx;
+
+        if (_two_ki > 0.0f) {
+            _ibx += _two_ki * ex * dt;
+            _iby += _two_ki * ey * dt;
+            _ibz += _two_ki * ez * dt;
+            gx += _ibx;
+            gy += _iby;
+            gz += _ibz;
+        }
+
+        gx += _two_kp * ex;
+        gy += _two_kp * ey;
+        gz += _two_kp * ez;
+    }
+
+    gx *= 0.5f * dt;
+    gy *= 0.5f * dt;
+    gz *= 0.5f * dt;
+    _q0 = q0 + (-q1 * gx - q2 * gy - q3 * gz);
+    _q1 = q1 + (q0 * gx + q2 * gz - q3 * gy);
+    _q2 = q2 + (q0 * gy - q1 * gz + q3 * gx);
+    _q3 = q3 + (q0 * gz + q1 * gy - q2 * gx);
+    normalize();
+}
@@ -0,0 +1,98 @@
+/*
+ * Orientation estimation from CurieIMU FIFO batches.
+ *
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CURIEIMUFUSION_H_
+#define _CURIEIMUFUSION_H_
+
+#include "CurieIMU.h"
+
+/**
+ * Filter options
+ * @see CurieIMUFusion::begin()
+ */
+typedef enum {
+    CURIE_IMU_FUSION_MADGWICK = 0,
+    CURIE_IMU_FUSION_MAHONY,
+} CurieIMUFusionFilter;
+
+/* Default gains: Madgwick's beta, and Mahony's proportional and integral
+ * gains, all doubled as in the original papers' code */
+#define CURIE_IMU_FUSION_BETA   0.1f
+#define CURIE_IMU_FUSION_2KP    1.0f
+#define CURIE_IMU_FUSION_2KI    0.0f
+
+/* BMI160 sensortime: 24 bits of 39.0625us */
+#define CURIE_IMU_SENSORTIME_US 39.0625f
+#define CURIE_IMU_SENSORTIME_MASK 0xFFFFFF
+
+/* Note that CurieIMUFusion runs a 6-axis (accelerometer + gyro) filter on
+ * the samples of CurieIMUFIFOBatch blocks, from readFIFO() or
+ * startAcquisition(). The time step of each sample is the FIFO's real
+ * output rate, measured from the sensortime frames that come with the
+ * batches, not from millis(). Quaternion updates are in single precision
+ * float with a reciprocal square root that needs no division, which keeps
+ * the soft-float cost per sample down.
+ *
+ * Please refer to CurieIMUFusion.cpp for documentation on each method.
+ */
+class CurieIMUFusion {
+    public:
+        CurieIMUFusion(CurieIMUClass& imu = CurieIMU);
+
+        void begin(float sampleRate,
+                   int filter = CURIE_IMU_FUSION_MADGWICK);
+        void setBeta(float beta);
+        void setMahonyGains(float twoKp, float twoKi);
+
+        int update(const CurieIMUFIFOBatch& batch);
+        void update(float gx, float gy, float gz,
+                    float ax, float ay, float az, float dt);
+
+        void getQuaternion(float& w, float& x, float& y, float& z);
+        float getRoll();
+        float getPitch();
+        float getYaw();
+        float getSamplePeriod();
+
+    private:
+        CurieIMUClass& _imu;
+        int _filter;
+        float _q0, _q1, _q2, _q3;
+        float _beta;
+        float _two_kp, _two_ki;
+        float _ibx, _iby, _ibz;
+        float _nominal_dt;
+        float _dt;
+        float _pending_dt;
+        unsigned _frames;
+        bool _have_time;
+        bool _aligned;
+        uint32_t _last_time;
+
+        void align(float ax, float ay, float az);
+        void madgwick(float gx, float gy, float gz,
+                      float ax, float ay, float az, float dt);
+        void mahony(float gx, float gy, float gz,
+                    float ax, float ay, float az, float dt);
+        void normalize();
+};
+
+#endif /* _CURIEIMUFUSION_H_ */
@@ -37,9 +37,7 @@ Rx does not work for pin 13
 // Statics
 //
 SoftwareSerial *SoftwareSerial::active_object = 0;
-char *SoftwareSerial::_receive_buffer;
-volatile uint8_t SoftwareSerial::_receive_buffer_tail = 0;
-volatile uint8_t SoftwareSerial::_receive_buffer_head = 0;
+RingBuffer *SoftwareSerial::_receive_buffer;
 
 static uint8_t _rxPin;
 static uint16_t bitDelay;
@@ -49,7 +47,6 @@ static int initRxIntraBitDelay;
 static int firstIntraBitDelay;
 static int initRxCenteringDelay;
 static bool firstStartBit = true;
-static bool bufferOverflow = true;
 static bool invertedLogic = false;
 static bool isSOCGpio = false;
 
@@ -86,8 +83,8 @@ bool SoftwareSerial::listen()
     if (active_object)
       active_object->stopListening();
 
-    bufferOverflow = false;
-    _receive_buffer_head = _receive_buffer_tail = 0;
+    _rx_buffer.clear();
+    _receive_buffer = &_rx_buffer;
     active_object = this;
     _rxPin = _receivePin;
     rxIntraBitDelay = _rx_delay_intrabit;
@@ -172,18 +169,12 @@ void SoftwareSerial::recv()
     if (invertedLogic)
       d = ~d;
 
-    uint8_t next = (_receive_buffer_tail + 1) % _SS_MAX_RX_BUFF;
-    if (next != _receive_buffer_head)
-    {
-      // save new data in buffer: tail points to where byte goes
-      _receive_buffer[_receive_buffer_tail] = d; // save new byte
-      _receive_buffer_tail = next;
-    } 
-    else 
-    {
+    // save new data in buffer, flagging an overflow if it is full
+    _receive_buffer->store_char(d);
+#if _DEBUG
+    if (_receive_buffer->isFull())
       DebugPulse(_DEBUG_PIN1, 1);
-      bufferOverflow = true;
-    }
+#endif
 
     // wait until we see a stop bit/s or timeout;
     uint8_t loopTimeout = 32;
@@ -217,20 +208,19 @@ uint32_t SoftwareSerial::rx_pin_read()
 //
 // Constructor
 //
-SoftwareSerial::SoftwareSerial(uint32_t receivePin, uint32_t transmitPin, bool inverse_logic /* = false */) : 
+SoftwareSerial::SoftwareSerial(uint32_t receivePin, uint32_t transmitPin, bool inverse_logic /* = false */, uint16_t rxBufferSize /* = _SS_MAX_RX_BUFF */) : 
   _rx_delay_centering(0),
   _rx_delay_intrabit(0),
   _rx_delay_stopbit(0),
   _tx_delay(0),
-  _buffer_overflow(false),
-  _inverse_logic(inverse_logic)
+  _inverse_logic(inverse_logic),
+  _rx_buffer(rxBufferSize)
 {
   _inverse_logic = inverse_logic;
   setTX(transmitPin);
   _transmitPin = transmitPin;
   setRX(receivePin);
   _receivePin = receivePin;
-  _receive_buffer = (char*)dccm_malloc(_SS_MAX_RX_BUFF);
 }
 
 //
@@ -330,14 +320,7 @@ int SoftwareSerial::read()
   if (!isListening())
     return -1;
 
-  // Empty buffer?
-  if (_receive_buffer_head == _receive_buffer_tail)
-    return -1;
-
-  // Read from "head"
-  uint8_t d = _receive_buffer[_receive_buffer_head]; // grab next byte
-  _receive_buffer_head = (_receive_buffer_head + 1) % _SS_MAX_RX_BUFF;
-  return d;
+  return _rx_buffer.read_char();
 }
 
 int SoftwareSerial::available()
@@ -345,7 +328,7 @@ int SoftwareSerial::available()
   if (!isListening())
     return -1;
 
-  return (_receive_buffer_tail + _SS_MAX_RX_BUFF - _receive_buffer_head) % _SS_MAX_RX_BUFF;
+  return _rx_buffer.available();
 }
 
 size_t SoftwareSerial::write(uint8_t b)
@@ -402,9 +385,7 @@ void SoftwareSerial::flush()
   if (!isListening())
     return;
 
-  noInterrupts();
-  _receive_buffer_head = _receive_buffer_tail = 0;
-  interrupts();
+  _rx_buffer.flush();
 }
 
 int SoftwareSerial::peek()
@@ -412,10 +393,5 @@ int SoftwareSerial::peek()
   if (!isListening())
     return -1;
 
-  // Empty buffer?
-  if (_receive_buffer_head == _receive_buffer_tail)
-    return -1;
-
-  // Read from "head"
-  return _receive_buffer[_receive_buffer_head];
+  return _rx_buffer.peek();
 }
@@ -28,11 +28,12 @@ Rx does not work for pin 13
 #include <inttypes.h>
 #include <Stream.h>
 #include <Arduino.h>
+#include <RingBuffer.h>
 /******************************************************************************
 * Definitions
 ******************************************************************************/
 
-#define _SS_MAX_RX_BUFF 64 // RX buffer size
+#define _SS_MAX_RX_BUFF 64 // default RX buffer size, rounded up to a power of two
 
 class SoftwareSerial : public Stream
 {
@@ -52,13 +53,12 @@ private:
   int _rx_delay_stopbit;
   int _tx_delay;
 
-  uint32_t _buffer_overflow:1;
   bool _inverse_logic = false;
 
+  RingBuffer _rx_buffer;
+
   // static data
-  static char *_receive_buffer;
-  static volatile uint8_t _receive_buffer_tail;
-  static volatile uint8_t _receive_buffer_head;
+  static RingBuffer *_receive_buffer;
   static SoftwareSerial *active_object;
 
   // private methods
@@ -76,14 +76,16 @@ private:
 
 public:
   // public methods
-  SoftwareSerial(uint32_t receivePin, uint32_t transmitPin, bool inverse_logic = false);
+  SoftwareSerial(uint32_t receivePin, uint32_t transmitPin, bool inverse_logic = false, uint16_t rxBufferSize = _SS_MAX_RX_BUFF);
   virtual ~SoftwareSerial();
+  // Resize the RX buffer (rounded up to a power of two); only while not listening
+  bool setRxBufferSize(uint16_t size) { return !isListening() && _rx_buffer.allocate(size); }
   void begin(long speed);
   bool listen();
   void end();
   bool isListening() { return this == active_object; }
   bool stopListening();
-  bool overflow() { bool ret = _buffer_overflow; if (ret) _buffer_overflow = false; return ret; }
+  bool overflow() { return _rx_buffer.overflow(); }
   int peek();
 
   virtual size_t write(uint8_t byte);
@@ -0,0 +1,60 @@
+/*
+  Poll two sensors
+
+  Reads the BMI160 accelerometer (6 bytes from 0x12) every 2 ms and the
+  gyroscope (6 bytes from 0x0C) every 5 ms in the background, and prints
+  the newest samples with the timing statistics once a second.
+
+  The addresses and registers are examples; change them to match the
+  sensors on your bus.
+
+  This example code is in the public domain.
+*/
+
+#include <Wire.h>
+#include <I2CPoller.h>
+
+I2CPoller poller;
+int accelJob;
+int gyroJob;
+unsigned long lastReport;
+
+void setup()
+{
+  Serial.begin(115200);
+  Wire.begin();
+
+  accelJob = poller.addJob(I2C_SENSING_0, 0x69, 0x12, 6, 2000);
+  gyroJob = poller.addJob(I2C_SENSING_0, 0x69, 0x0C, 6, 5000);
+  poller.begin(500);
+}
+
+void report(const char *name, int job)
+{
+  uint8_t data[6];
+  uint32_t stamp;
+  I2CPollerStats stats;
+
+  poller.read(job, data, &stamp);
+  poller.getStats(job, &stats);
+
+  Serial.print(name);
+  Serial.printf(" t=%lu x=%d y=%d z=%d", (unsigned long)stamp,
+                (int16_t)(data[0] | data[1] << 8),
+                (int16_t)(data[2] | data[3] << 8),
+                (int16_t)(data[4] | data[5] << 8));
+  Serial.printf(" samples=%lu skipped=%lu errors=%lu latency=%lu/%lu/%lu jitter=%lu\n",
+                (unsigned long)stats.samples, (unsigned long)stats.skipped,
+                (unsigned long)stats.errors, (unsigned long)stats.latencyMin,
+                (unsigned long)stats.latencyAvg, (unsigned long)stats.latencyMax,
+                (unsigned long)stats.jitterMax);
+}
+
+void loop()
+{
+  if (millis() - lastReport >= 1000) {
+    lastReport = millis();
+    report("accel", accelJob);
+    report("gyro", gyroJob);
+  }
+}
@@ -0,0 +1,224 @@
+/*
+ * I2CPoller.cpp - periodic register reads on the sensing subsystem I2C
+ *                 controllers, delivered as double-buffered snapshots
+ *
+ * Copyright (C) 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <string.h>
+#include <Arduino.h>
+#include <CurieTimerOne.h>
+#include "I2CPoller.h"
+
+extern "C" {
+#include <i2c.h>
+}
+
+I2CPoller *I2CPoller::_timerOwner = NULL;
+
+I2CPoller::I2CPoller()
+  : _count(0), _started(false), _primed(false)
+{
+  memset(_jobs, 0, sizeof(_jobs));
+}
+
+int I2CPoller::addJob(I2C_CONTROLLER controller, uint8_t address, uint8_t reg,
+                      uint8_t len, uint32_t periodUs)
+{
+  if (_started || _count == I2C_POLLER_MAX_JOBS)
+    return -1;
+  if (len == 0 || len > I2C_POLLER_MAX_LEN || periodUs == 0)
+    return -1;
+
+  Job &j = _jobs[_count];
+  memset(&j, 0, sizeof(j));
+  j.controller = controller;
+  j.reg = reg;
+  j.len = len;
+  j.period = periodUs;
+  j.stats.latencyMin = 0xFFFFFFFF;
+
+  j.xfer.addr = address;
+  j.xfer.tx = &j.reg;
+  j.xfer.tx_len = 1;
+  j.xfer.rx_len = len;
+  j.xfer.done = complete;
+  j.xfer.arg = &j;
+
+  _primed = false;
+  return _count++;
+}
+
+void I2CPoller::service(uint32_t nowUs)
+{
+  // Every job is first due on the first step after it was added
+  if (!_primed) {
+    for (uint8_t i = 0; i < _count; i++)
+      _jobs[i].nextDue = nowUs;
+    _primed = true;
+  }
+
+  // Queue everything that is due in one go: the I2C engine then runs the
+  // transfers back to back from its own interrupt
+  for (uint8_t i = 0; i < _count; i++) {
+    Job &j = _jobs[i];
+
+    if ((int32_t)(nowUs - j.nextDue) < 0)
+      continue;
+
+    if (j.busy) {
+      j.stats.skipped++;
+    } else {
+      j.issuedDue = j.nextDue;
+      j.xfer.rx = j.buf[j.front ^ 1];
+      j.busy = true;
+      if (i2c_async_submit(j.controller, &j.xfer) != I2C_OK) {
+        j.busy = false;
+        j.stats.errors++;
+      }
+    }
+
+    // Stay on the period grid; periods that already passed are skipped
+    j.nextDue += j.period;
+    if ((int32_t)(nowUs - j.nextDue) >= 0) {
+      uint32_t behind = (nowUs - j.nextDue) / j.period + 1;
+      j.stats.skipped += behind;
+      j.nextDue += behind * j.period;
+    }
+  }
+}
+
+void I2CPoller::complete(i2c_xfer_t *xfer)
+{
+  Job &j = *(Job *)xfer->arg;
+  uint32_t now = (uint32_t)micros();
+
+  if (xfer->status == I2C_OK) {
+    uint8_t back = j.front ^ 1;
+    j.stamp[back] = now;
+    j.front = back;
+    j.seq++;
+
+    uint32_t latency = now - j.issuedDue;
+    if (latency < j.stats.latencyMin)
+      j.stats.latencyMin = latency;
+    if (latency > j.stats.latencyMax)
+      j.stats.latencyMax = latency;
+    j.latencySum += latency;
+
+    // Only consecutive periods say anything about jitter
+    if (j.stats.samples != 0 && j.issuedDue - j.lastDue == j.period) {
+      uint32_t interval = now - j.lastStamp;
+      uint32_t dev = (interval > j.period) ? interval - j.period : j.period - interval;
+      if (dev > j.stats.jitterMax)
+        j.stats.jitterMax = dev;
+    }
+    j.lastStamp = now;
+    j.lastDue = j.issuedDue;
+    j.stats.samples++;
+  } else {
+    j.stats.errors++;
+  }
+  j.busy = false;
+}
+
+bool I2CPoller::read(int job, uint8_t *data, uint32_t *timestampUs)
+{
+  if (job < 0 || job >= _count)
+    return false;
+
+  Job &j = _jobs[job];
+  uint32_t seq;
+  uint32_t stamp;
+
+  // The interrupt only writes the buffer that is not published, so a copy
+  // is torn only if two samples complete meanwhile; retry then
+  do {
+    seq = j.seq;
+    uint8_t front = j.front;
+    memcpy(data, j.buf[front], j.len);
+    stamp = j.stamp[front];
+  } while (seq != j.seq);
+
+  if (timestampUs)
+    *timestampUs = stamp;
+  bool fresh = (seq != j.readSeq);
+  j.readSeq = seq;
+  return fresh;
+}
+
+bool I2CPoller::available(int job) const
+{
+  if (job < 0 || job >= _count)
+    return false;
+  return _jobs[job].seq != _jobs[job].readSeq;
+}
+
+void I2CPoller::getStats(int job, I2CPollerStats *stats) const
+{
+  if (job < 0 || job >= _count)
+    return;
+
+  const Job &j = _jobs[job];
+  uint32_t saved = interrupt_lock();
+  *stats = j.stats;
+  stats->latencyAvg = j.stats.samples ? (uint32_t)(j.latencySum / j.stats.samples) : 0;
+  if (j.stats.samples == 0)
+    stats->latencyMin = 0;
+  interrupt_unlock(saved);
+}
+
+void I2CPoller::resetStats(int job)
+{
+  if (job < 0 || job >= _count)
+    return;
+
+  Job &j = _jobs[job];
+  uint32_t saved = interrupt_lock();
+  memset(&j.stats, 0, sizeof(j.stats));
+  j.stats.latencyMin = 0xFFFFFFFF;
+  j.latencySum = 0;
+  interrupt_unlock(saved);
+}
+
+void I2CPoller::timerTick(void)
+{
+  if (_timerOwner)
+    _timerOwner->service((uint32_t)micros());
+}
+
+void I2CPoller::begin(uint32_t tickUs)
+{
+  _timerOwner = this;
+  _started = true;
+  _primed = false;
+  CurieTimerOne.start(tickUs, timerTick);
+}
+
+void I2CPoller::end(void)
+{
+  CurieTimerOne.kill();
+  _timerOwner = NULL;
+  _started = false;
+  // Queued reads go at once; one on the bus finishes first, or is aborted
+  // with the controller reset if it does not, before its buffer is let go
+  for (uint8_t i = 0; i < _count; i++)
+    i2c_async_cancel(&_jobs[i].xfer, I2C_ERROR);
+  for (uint8_t i = 0; i < _count; i++)
+    i2c_async_wait(&_jobs[i].xfer, I2C_POLLER_STOP_MS);
+}
@@ -0,0 +1,110 @@
+/*
+ * I2CPoller.h - periodic register reads on the sensing subsystem I2C
+ *               controllers, delivered as double-buffered snapshots
+ *
+ * Copyright (C) 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef I2CPoller_h
+#define I2CPoller_h
+
+#include <inttypes.h>
+#include <i2c_async.h>
+
+#define I2C_POLLER_MAX_JOBS  8
+#define I2C_POLLER_MAX_LEN   32
+// How long end() lets a read already on the bus finish
+#define I2C_POLLER_STOP_MS   16
+
+// All times in microseconds
+struct I2CPollerStats {
+  uint32_t samples;
+  uint32_t errors;
+  uint32_t skipped;       // periods missed because the bus was still busy
+  uint32_t latencyMin;    // due time to data in the snapshot
+  uint32_t latencyMax;
+  uint32_t latencyAvg;
+  uint32_t jitterMax;     // worst deviation of a sample interval from the period
+};
+
+class I2CPoller
+{
+public:
+  I2CPoller();
+
+  // Read 'len' bytes from register 'reg' of 'address' every 'periodUs'.
+  // Returns the job number, or -1 when the job table is full or 'len'
+  // exceeds I2C_POLLER_MAX_LEN. Jobs can only be added while stopped.
+  int addJob(I2C_CONTROLLER controller, uint8_t address, uint8_t reg,
+             uint8_t len, uint32_t periodUs);
+
+  // Drive the scheduler from CurieTimerOne every 'tickUs'. The controllers
+  // must already be open, e.g. through Wire.begin(). end() waits for reads
+  // on the bus and must not be called from an interrupt.
+  void begin(uint32_t tickUs = 1000);
+  void end(void);
+
+  // One scheduler step: queue every job due at 'nowUs' back to back.
+  // begin() calls this from the timer interrupt; without begin() it can be
+  // called from loop() or with a simulated clock instead.
+  void service(uint32_t nowUs);
+
+  // Copy the latest snapshot of 'job' into 'data' without blocking.
+  // Returns true if it is newer than the one returned last time.
+  bool read(int job, uint8_t *data, uint32_t *timestampUs = NULL);
+  bool available(int job) const;
+
+  void getStats(int job, I2CPollerStats *stats) const;
+  void resetStats(int job);
+
+private:
+  struct Job {
+    i2c_xfer_t xfer;
+    I2C_CONTROLLER controller;
+    uint8_t reg;
+    uint8_t len;
+    uint32_t period;
+    uint32_t nextDue;
+    uint32_t issuedDue;
+    volatile bool busy;
+
+    // Written by the completion interrupt into the back buffer, then
+    // published by flipping 'front' and bumping 'seq'
+    uint8_t buf[2][I2C_POLLER_MAX_LEN];
+    volatile uint32_t stamp[2];
+    volatile uint8_t front;
+    volatile uint32_t seq;
+    uint32_t readSeq;
+
+    uint32_t lastStamp;
+    uint32_t lastDue;
+    uint64_t latencySum;
+    I2CPollerStats stats;
+  };
+
+  static void complete(i2c_xfer_t *xfer);
+  static void timerTick(void);
+  static I2CPoller *_timerOwner;
+
+  Job _jobs[I2C_POLLER_MAX_JOBS];
+  uint8_t _count;
+  bool _started;
+  bool _primed;
+};
+
+#endif
@@ -27,6 +27,7 @@
  */
 
 #include <malloc.h>
+#include "dccm/dccm_alloc.h"
 #include "MemoryFree.h"
 
 extern char __start_heap;
@@ -56,3 +57,33 @@ int freeMemory (void) {
     int stack = freeStack();
     return (stack < 0) ? heap : stack + heap;
 }
+
+int freeDCCM (void) {
+    struct dccm_stats st;
+
+    dccm_get_stats(&st);
+    return st.free;
+}
+
+int largestFreeDCCM (void) {
+    struct dccm_stats st;
+
+    dccm_get_stats(&st);
+    return st.largestFree;
+}
+
+int highWaterDCCM (void) {
+    struct dccm_stats st;
+
+    dccm_get_stats(&st);
+    return st.highWater;
+}
+
+int fragmentationDCCM (void) {
+    struct dccm_stats st;
+
+    dccm_get_stats(&st);
+    if (st.free == 0)
+        return 0;
+    return 100 - (int)(((uint32_t)st.largestFree * 100) / st.free);
+}
@@ -41,6 +41,23 @@ int freeStack(void);
  * space will be returned. */
 int freeMemory(void);
 
+/* freeDCCM: returns the number of bytes still available for allocation from
+ * the DCCM heap (see dccm_alloc.h), summed over all free blocks. */
+int freeDCCM(void);
+
+/* largestFreeDCCM: returns the size (in bytes) of the largest single DCCM
+ * allocation that can currently succeed. */
+int largestFreeDCCM(void);
+
+/* highWaterDCCM: returns the peak number of DCCM bytes in use, headers
+ * included, since startup. */
+int highWaterDCCM(void);
+
+/* fragmentationDCCM: returns how fragmented the free DCCM space is, as a
+ * percentage. 0 means all free space is one block, values close to 100
+ * mean free space is scattered over many small blocks. */
+int fragmentationDCCM(void);
+
 #ifdef __cplusplus
 }
 #endif
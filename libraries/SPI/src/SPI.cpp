@@ -21,6 +21,464 @@
 SPIClass SPI(SPIDEV_1);
 SPIClass SPI1(SPIDEV_0);
 
+/* Sent by transfers without a TX buffer */
+static const uint8_t spiIdleByte = 0xFF;
+/* Where DMA drops what comes back for segments without an RX buffer */
+static uint8_t spiSink;
+
+static inline bool inDCCM(const void *p, size_t count)
+{
+    uint32_t a = (uint32_t)p;
+    return p && a < DCCM_START + DCCM_SIZE && a + count > DCCM_START;
+}
+
+/* Whether a DMA completion interrupt can come while the caller spins on it:
+ * not with interrupts off, nor from inside an interrupt handler */
+static inline bool dmaCanWait(void)
+{
+    return (READ_ARC_REG(ARC_V2_STATUS32) & ARC_V2_STATUS32_IE) &&
+           READ_ARC_REG(ARC_V2_AUX_IRQ_ACT) == 0;
+}
+
+/* Through the FIFO, SPI_FIFO_DEPTH bytes at a time */
+void SPIClass::fifoTransfer(const uint8_t *tx, uint8_t *rx, size_t count)
+{
+    setFrameSize(SPI_8_BIT);
+    while (count > 0) {
+        uint32_t transferSize = SPI_FIFO_DEPTH > count ? count : SPI_FIFO_DEPTH;
+        uint32_t i;
+        /* Fill the TX FIFO */
+        for (i = 0; i < transferSize; i++) {
+            uint8_t b = tx ? tx[i] : spiIdleByte;
+            SPI_M_REG_VAL(spi_addr, DR) = lsbFirst ? SPI_REVERSE_8(b) : b;
+        }
+        if (tx)
+            tx += transferSize;
+        count -= transferSize;
+        /* Wait for transfer to complete */
+        while (SPI_M_REG_VAL(spi_addr, SR) & SPI_STATUS_BUSY) ;
+        do {
+            uint32_t rxLevel = SPI_M_REG_VAL(spi_addr, RXFL);
+            /* Drain the RX FIFO */
+            for (i = 0; i < rxLevel; i++) {
+                uint8_t b = SPI_M_REG_VAL(spi_addr, DR);
+                if (rx)
+                    *rx++ = lsbFirst ? SPI_REVERSE_8(b) : b;
+            }
+            transferSize -= rxLevel;
+        } while (transferSize);
+    }
+}
+
+/* One 16 or 32-bit frame's worth, swapped and reversed as asked; both are
+ * their own inverse and commute, so this goes both ways */
+static inline uint32_t spiWord(uint32_t w, bool wide, bool swap, bool lsbFirst)
+{
+    if (swap)
+        w = wide ? SPI_SWAP_32(w) : SPI_SWAP_16(w);
+    if (lsbFirst)
+        w = wide ? SPI_REVERSE_32(w) : SPI_REVERSE_16(w);
+    return w;
+}
+
+/* Whole words through the FIFO at the native frame size, which is one FIFO
+ * access per word instead of one per byte. The TX FIFO is topped up as the
+ * RX FIFO drains, never with more frames in flight than the RX FIFO holds */
+void SPIClass::wordTransfer(void *buf, size_t count, uint32_t size, bool swap)
+{
+    bool wide = (size == SPI_32_BIT);
+    uint16_t *buf16 = (uint16_t *)buf;
+    uint32_t *buf32 = (uint32_t *)buf;
+    size_t in = 0, out = 0;
+
+    setFrameSize(size);
+    while (out < count) {
+        /* Fill the TX FIFO */
+        for (; in < count && in - out < SPI_FIFO_DEPTH; in++) {
+            uint32_t w = wide ? buf32[in] : buf16[in];
+            SPI_M_REG_VAL(spi_addr, DR) = spiWord(w, wide, swap, lsbFirst);
+        }
+        /* Drain whatever has come back */
+        for (uint32_t rxLevel = SPI_M_REG_VAL(spi_addr, RXFL); rxLevel > 0;
+             rxLevel--, out++) {
+            uint32_t w = spiWord(SPI_M_REG_VAL(spi_addr, DR), wide, swap,
+                                 lsbFirst);
+            if (wide)
+                buf32[out] = w;
+            else
+                buf16[out] = w;
+        }
+    }
+}
+
+bool SPIClass::dmaAcquire(void)
+{
+    if (dmaReady)
+        return true;
+    dma_shared_init();
+    if (soc_dma_acquire(&dmaTxChannel) != DRV_RC_OK)
+        return false;
+    if (soc_dma_acquire(&dmaRxChannel) != DRV_RC_OK) {
+        soc_dma_release(&dmaTxChannel);
+        return false;
+    }
+
+    memset(&dmaTxCfg, 0, sizeof(dmaTxCfg));
+    dmaTxCfg.type = SOC_DMA_TYPE_MEM2PER;
+    dmaTxCfg.dest_interface = dmaTxInterface;
+    dmaTxCfg.xfer.src.width = SOC_DMA_WIDTH_8;
+    dmaTxCfg.xfer.dest.delta = SOC_DMA_DELTA_NONE;
+    dmaTxCfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+    dmaTxCfg.xfer.dest.addr = (void *)(spi_addr + DR);
+    dmaTxCfg.cb_done = dmaTxDone;
+    dmaTxCfg.cb_done_arg = this;
+    dmaTxCfg.cb_err = dmaError;
+    dmaTxCfg.cb_err_arg = this;
+
+    memset(&dmaRxCfg, 0, sizeof(dmaRxCfg));
+    dmaRxCfg.type = SOC_DMA_TYPE_PER2MEM;
+    dmaRxCfg.src_interface = dmaRxInterface;
+    dmaRxCfg.xfer.src.delta = SOC_DMA_DELTA_NONE;
+    dmaRxCfg.xfer.src.width = SOC_DMA_WIDTH_8;
+    dmaRxCfg.xfer.src.addr = (void *)(spi_addr + DR);
+    dmaRxCfg.xfer.dest.delta = SOC_DMA_DELTA_INCR;
+    dmaRxCfg.xfer.dest.width = SOC_DMA_WIDTH_8;
+    dmaRxCfg.cb_done = dmaRxDone;
+    dmaRxCfg.cb_done_arg = this;
+    dmaRxCfg.cb_err = dmaError;
+    dmaRxCfg.cb_err_arg = this;
+
+    dmaReady = true;
+    return true;
+}
+
+void SPIClass::dmaRelease(void)
+{
+    if (!dmaReady)
+        return;
+    soc_dma_stop_transfer(&dmaTxChannel);
+    soc_dma_stop_transfer(&dmaRxChannel);
+    soc_dma_release(&dmaTxChannel);
+    soc_dma_release(&dmaRxChannel);
+    SPI_M_REG_VAL(spi_addr, DMACR) = 0;
+    dmaReady = false;
+    dmaBusy = false;
+    txn = NULL;
+}
+
+/* Lay the segments out as one list per direction, the config's own item
+ * first and then 'more'; the peripheral side stays on DR. Segments without
+ * a buffer send spiIdleByte or drop what comes back into spiSink. False if
+ * that takes more than SPI_DMA_ITEMS items */
+bool SPIClass::dmaChain(struct soc_dma_cfg *cfg,
+                        struct soc_dma_xfer_item *more,
+                        const SPISegment *seg, uint8_t n, bool tx)
+{
+    struct soc_dma_xfer_item *end = more + SPI_DMA_ITEMS - 1;
+    struct soc_dma_xfer_item *item = NULL;
+
+    for (; n > 0; seg++, n--) {
+        uint8_t *mem = (uint8_t *)(tx ? (void *)seg->tx : seg->rx);
+        size_t count = seg->len;
+
+        while (count > 0) {
+            if (!item) {
+                item = &cfg->xfer;
+            } else {
+                if (more == end)
+                    return false;
+                *more = *item;
+                item->next = more;
+                item = more++;
+            }
+            item->size = count > SPI_DMA_ITEM_MAX ? SPI_DMA_ITEM_MAX : count;
+            if (tx) {
+                item->src.addr = mem ? (void *)mem : (void *)&spiIdleByte;
+                item->src.delta = mem ? SOC_DMA_DELTA_INCR : SOC_DMA_DELTA_NONE;
+            } else {
+                item->dest.addr = mem ? (void *)mem : (void *)&spiSink;
+                item->dest.delta = mem ? SOC_DMA_DELTA_INCR : SOC_DMA_DELTA_NONE;
+            }
+            count -= item->size;
+            if (mem)
+                mem += item->size;
+        }
+    }
+    if (!item)
+        return false;
+    item->next = NULL;
+    return true;
+}
+
+/* DMA cannot reach DCCM */
+bool SPIClass::dmaUsable(const SPISegment *seg, uint8_t n)
+{
+    for (; n > 0; seg++, n--)
+        if (inDCCM(seg->tx, seg->len) || inDCCM(seg->rx, seg->len))
+            return false;
+    return dmaAcquire();
+}
+
+/* Start one DMA run over 'n' segments */
+bool SPIClass::dmaStart(const SPISegment *seg, uint8_t n)
+{
+    uint32_t ctrl0;
+    uint8_t i;
+
+    dmaTxOnly = true;
+    for (i = 0; i < n; i++)
+        if (seg[i].rx && seg[i].len)
+            dmaTxOnly = false;
+
+    if (!dmaChain(&dmaTxCfg, dmaTxItems, seg, n, true))
+        return false;
+    soc_dma_deconfig(&dmaTxChannel);
+    if (soc_dma_config(&dmaTxChannel, &dmaTxCfg) != DRV_RC_OK)
+        return false;
+    if (!dmaTxOnly) {
+        if (!dmaChain(&dmaRxCfg, dmaRxItems, seg, n, false))
+            return false;
+        soc_dma_deconfig(&dmaRxChannel);
+        if (soc_dma_config(&dmaRxChannel, &dmaRxCfg) != DRV_RC_OK)
+            return false;
+    }
+
+    /* Both channels wait for the controller's handshake; receiver first,
+     * so it is ready when the first byte comes back */
+    if (!dmaTxOnly && soc_dma_start_transfer(&dmaRxChannel) != DRV_RC_OK)
+        return false;
+    if (soc_dma_start_transfer(&dmaTxChannel) != DRV_RC_OK) {
+        soc_dma_stop_transfer(&dmaRxChannel);
+        return false;
+    }
+
+    setFrameSize(SPI_8_BIT);
+    /* Transmit-only while nothing is to be received, so the RX FIFO
+     * cannot overflow and need not be drained */
+    SPI_M_REG_VAL(spi_addr, SPIEN) &= SPI_DISABLE;
+    ctrl0 = SPI_M_REG_VAL(spi_addr, CTRL0) & ~SPI_TMOD_MASK;
+    SPI_M_REG_VAL(spi_addr, CTRL0) = ctrl0 | (dmaTxOnly ? SPI_TMOD_TX_ONLY : 0);
+    /* Ask for more data with half the TX FIFO free, hand over each byte
+     * received straight away */
+    SPI_M_REG_VAL(spi_addr, DMATDLR) = SPI_FIFO_DEPTH / 2;
+    SPI_M_REG_VAL(spi_addr, DMARDLR) = 0;
+    SPI_M_REG_VAL(spi_addr, SPIEN) |= SPI_ENABLE;
+    SPI_M_REG_VAL(spi_addr, DMACR) =
+        SPI_DMA_TX_ENABLE | (dmaTxOnly ? 0 : SPI_DMA_RX_ENABLE);
+    return true;
+}
+
+bool SPIClass::transfer(const void *tx, void *rx, size_t count,
+                        SPICallback callback, void *arg)
+{
+    SPISegment seg = { tx, rx, count, 0, 0 };
+
+    if (count == 0 || dmaBusy)
+        return false;
+
+    if (lsbFirst || !dmaUsable(&seg, 1)) {
+        fifoTransfer((const uint8_t *)tx, (uint8_t *)rx, count);
+        if (callback)
+            callback(arg, 0);
+        return true;
+    }
+
+    dmaBusy = true;
+    dmaCallback = callback;
+    dmaArg = arg;
+    if (!dmaStart(&seg, 1)) {
+        dmaBusy = false;
+        return false;
+    }
+    return true;
+}
+
+void SPIClass::transfer(const void *tx, void *rx, size_t count)
+{
+    if (count < SPI_DMA_THRESHOLD || !dmaCanWait() ||
+        !transfer(tx, rx, count, NULL, NULL)) {
+        /* Too short, too long or no DMA: through the FIFO instead */
+        while (dmaBusy) ;
+        fifoTransfer((const uint8_t *)tx, (uint8_t *)rx, count);
+        return;
+    }
+    while (dmaBusy) ;
+}
+
+/* Chip select and delay after 'seg', when another segment follows */
+void SPIClass::txnGap(uint8_t csPin, const SPISegment *seg)
+{
+    if (seg->flags & SPI_SEGMENT_CS_RELEASE)
+        digitalWrite(csPin, HIGH);
+    if (seg->delayUs)
+        delayMicroseconds(seg->delayUs);
+    if (seg->flags & SPI_SEGMENT_CS_RELEASE)
+        digitalWrite(csPin, LOW);
+}
+
+/* The whole transaction through the FIFO */
+void SPIClass::txnFifo(const SPITransaction &t)
+{
+    uint8_t i;
+
+    beginTransaction(t.settings);
+    digitalWrite(t.csPin, LOW);
+    for (i = 0; i < t.count; i++) {
+        const SPISegment *seg = &t.segments[i];
+        fifoTransfer((const uint8_t *)seg->tx, (uint8_t *)seg->rx, seg->len);
+        if (i + 1 < t.count)
+            txnGap(t.csPin, seg);
+    }
+    digitalWrite(t.csPin, HIGH);
+    endTransaction();
+}
+
+/* Start the next DMA run of the running transaction: the segments up to
+ * the next CS release or delay, as many as fit in the item lists. Returns
+ * 1 once started, 0 when no segments are left and -1 on failure */
+int SPIClass::txnStep(void)
+{
+    while (txnNext < txn->count) {
+        uint8_t first = txnNext;
+        size_t items = 0, bytes = 0;
+
+        while (txnNext < txn->count) {
+            const SPISegment *seg = &txn->segments[txnNext];
+            size_t need = (seg->len + SPI_DMA_ITEM_MAX - 1) / SPI_DMA_ITEM_MAX;
+
+            if (items && items + need > SPI_DMA_ITEMS)
+                break;
+            items += need;
+            bytes += seg->len;
+            txnNext++;
+            if (seg->flags & SPI_SEGMENT_CS_RELEASE || seg->delayUs)
+                break;
+        }
+        if (bytes)
+            return dmaStart(&txn->segments[first], txnNext - first) ? 1 : -1;
+        /* Nothing to move, only the step after it */
+        if (txnNext < txn->count)
+            txnGap(txn->csPin, &txn->segments[txnNext - 1]);
+    }
+    return 0;
+}
+
+void SPIClass::txnEnd(void)
+{
+    digitalWrite(txn->csPin, HIGH);
+    txn = NULL;
+    endTransaction();
+}
+
+bool SPIClass::transfer(const SPITransaction &t, SPICallback callback,
+                        void *arg)
+{
+    int ret;
+
+    if (t.count == 0 || dmaBusy)
+        return false;
+
+    /* With every interrupt masked by the transaction, the DMA completion
+     * could never run */
+    if (t.settings.lsbFirst || interruptMode >= 8 ||
+        !dmaUsable(t.segments, t.count)) {
+        txnFifo(t);
+        if (callback)
+            callback(arg, 0);
+        return true;
+    }
+
+    dmaBusy = true;
+    dmaCallback = callback;
+    dmaArg = arg;
+    beginTransaction(t.settings);
+    digitalWrite(t.csPin, LOW);
+    txn = &t;
+    txnNext = 0;
+    ret = txnStep();
+    if (ret > 0)
+        return true;
+    txnEnd();
+    dmaBusy = false;
+    if (ret < 0)
+        return false;
+    if (callback)
+        callback(arg, 0);
+    return true;
+}
+
+void SPIClass::transfer(const SPITransaction &t)
+{
+    if (!dmaCanWait() || !transfer(t, NULL, NULL)) {
+        while (dmaBusy) ;
+        txnFifo(t);
+        return;
+    }
+    while (dmaBusy) ;
+}
+
+void SPIClass::dmaFinish(int status)
+{
+    uint32_t ctrl0;
+    int more = 0;
+
+    SPI_M_REG_VAL(spi_addr, DMACR) = 0;
+    if (dmaTxOnly) {
+        /* The DMA is done once the last byte is in the FIFO; let it out
+         * before leaving transmit-only mode */
+        while (!(SPI_M_REG_VAL(spi_addr, SR) & SPI_STATUS_TFE)) ;
+        while (SPI_M_REG_VAL(spi_addr, SR) & SPI_STATUS_BUSY) ;
+        SPI_M_REG_VAL(spi_addr, SPIEN) &= SPI_DISABLE;
+        ctrl0 = SPI_M_REG_VAL(spi_addr, CTRL0) & ~SPI_TMOD_MASK;
+        SPI_M_REG_VAL(spi_addr, CTRL0) = ctrl0;
+        SPI_M_REG_VAL(spi_addr, SPIEN) |= SPI_ENABLE;
+    }
+    if (txn) {
+        /* On to the next run of the transaction, if any */
+        if (status == 0 && txnNext < txn->count) {
+            txnGap(txn->csPin, &txn->segments[txnNext - 1]);
+            more = txnStep();
+        }
+        if (more > 0)
+            return;
+        if (more < 0)
+            status = -1;
+        txnEnd();
+    }
+    dmaBusy = false;
+    if (dmaCallback)
+        dmaCallback(dmaArg, status);
+}
+
+void SPIClass::dmaTxDone(void *arg)
+{
+    SPIClass *spi = (SPIClass *)arg;
+    /* With reception on, the RX side finishes last */
+    if (spi->dmaTxOnly)
+        spi->dmaFinish(0);
+}
+
+void SPIClass::dmaRxDone(void *arg)
+{
+    ((SPIClass *)arg)->dmaFinish(0);
+}
+
+void SPIClass::dmaError(void *arg)
+{
+    SPIClass *spi = (SPIClass *)arg;
+
+    if (!spi->dmaBusy)
+        return;
+    soc_dma_stop_transfer(&spi->dmaTxChannel);
+    soc_dma_stop_transfer(&spi->dmaRxChannel);
+    spi->dmaTxOnly = false;
+    /* Whatever is left in the controller goes */
+    SPI_M_REG_VAL(spi->spi_addr, SPIEN) &= SPI_DISABLE;
+    SPI_M_REG_VAL(spi->spi_addr, CTRL0) &= ~SPI_TMOD_MASK;
+    SPI_M_REG_VAL(spi->spi_addr, SPIEN) |= SPI_ENABLE;
+    spi->dmaFinish(-1);
+}
+
 void SPIClass::setClockDivider(uint8_t clockDiv)
 {
     /* disable controller */
@@ -110,6 +568,7 @@ void SPIClass::end() {
         initialized--;
     /* If there are no more references disable SPI */
     if (!initialized) {
+        dmaRelease();
         SPI_M_REG_VAL(spi_addr, SPIEN) &= SPI_DISABLE;
         MMIO_REG_VAL(PERIPH_CLK_GATE_CTRL) &= disable_val;
 #ifdef SPI_TRANSACTION_MISMATCH_LED
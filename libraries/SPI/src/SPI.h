@@ -16,6 +16,8 @@
 #define _SPI_H_INCLUDED
 
 #include <Arduino.h>
+#include <soc_dma.h>
+#include <dma_shared.h>
 
 #include "SPI_registers.h"
 
@@ -72,6 +74,38 @@
 
 #define NUM_SPIDEVS 2
 
+/* Blocking transfers shorter than this are not worth setting up DMA for */
+#ifndef SPI_DMA_THRESHOLD
+#define SPI_DMA_THRESHOLD 16
+#endif
+/* A DMA list item moves at most 65535 bytes; this many items per direction
+ * bound one DMA run, be it a long transfer or several segments */
+#ifndef SPI_DMA_ITEMS
+#define SPI_DMA_ITEMS     8
+#endif
+#define SPI_DMA_ITEM_MAX  0xFFFF
+
+/* Completion of an asynchronous transfer, from the DMA interrupt;
+ * 'status' is 0 on success and negative if the DMA controller failed */
+typedef void (*SPICallback)(void *arg, int status);
+
+/* SPISegment flags */
+#define SPI_SEGMENT_CS_RELEASE 0x01 /* Deassert chip select after the segment */
+
+/* One piece of an SPITransaction: 'len' bytes from 'tx' (0xFF when NULL)
+ * with what comes back in 'rx' (dropped when NULL). Unless it is the last
+ * segment, chip select is then pulsed high if SPI_SEGMENT_CS_RELEASE is set
+ * and the bus stays idle for 'delayUs' microseconds, with chip select high
+ * during the delay when both are given. A zero length segment only does
+ * the CS/delay part */
+struct SPISegment {
+  const void *tx;
+  void *rx;
+  size_t len;
+  uint8_t flags;
+  uint16_t delayUs;
+};
+
 class SPISettings {
 public:
   SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {
@@ -100,6 +134,21 @@ private:
   friend class SPIClass;
 };
 
+/* A command/response exchange with one device: chip select 'csPin' (set as
+ * OUTPUT by the sketch) goes low, the segments run back to back with the
+ * bus in 'settings', then chip select goes high again. The transaction
+ * and its segments are read as it goes, so they must stay put until it
+ * completes */
+class SPITransaction {
+public:
+  SPITransaction(SPISettings settings, uint8_t csPin, const SPISegment *segments,
+                 uint8_t count)
+    : settings(settings), csPin(csPin), segments(segments), count(count) {}
+  SPISettings settings;
+  uint8_t csPin;
+  const SPISegment *segments;
+  uint8_t count;
+};
 
 class SPIClass {
 public:
@@ -108,6 +157,10 @@ public:
 	  enable_val = spidevs[dev][1];
 	  disable_val = spidevs[dev][2];
 	  ss_gpio = spidevs[dev][3];
+	  dmaTxInterface = spidevs[dev][4];
+	  dmaRxInterface = spidevs[dev][5];
+	  dmaReady = false;
+	  dmaBusy = false;
   }
 
   /* Initialize the SPI library */
@@ -197,37 +250,46 @@ public:
   }
 
   inline void transfer(void *buf, size_t count) {
-      setFrameSize(SPI_8_BIT);
-      size_t remaining = count;
-      uint8_t *p = (uint8_t *)buf;
-      if (lsbFirst) {
-          for (uint32_t i = 0; i < count; i++)
-              p[i] = SPI_REVERSE_8(p[i]);
-      }
-      while (remaining > 0) {
-          uint32_t transferSize = SPI_FIFO_DEPTH > remaining ? remaining : SPI_FIFO_DEPTH;
-          /* Fill the TX FIFO */
-          for (uint32_t i = 0; i < transferSize; i++)
-              SPI_M_REG_VAL(spi_addr, DR) = *(p + i);
-          remaining -= transferSize;
-          /* Wait for transfer to complete */
-          while (SPI_M_REG_VAL(spi_addr, SR) & SPI_STATUS_BUSY) ;
-          do {
-              uint32_t rxLevel = SPI_M_REG_VAL(spi_addr, RXFL);
-              /* Drain the RX FIFO */
-              for (uint32_t i = 0; i < rxLevel; i++)
-                  *(p + i) = SPI_M_REG_VAL(spi_addr, DR);
-              p += rxLevel;
-              transferSize -= rxLevel;
-          } while (transferSize);
-      }
-      if (lsbFirst) {
-          p = (uint8_t *)buf;
-          for (uint32_t i = 0; i < count; i++)
-              p[i] = SPI_REVERSE_8(p[i]);
-      }
+      transfer(buf, buf, count);
   }
 
+  /* 'count' words in place, each one frame of the word's size sent most
+   * significant bit first and replaced by the frame received. With 'swap'
+   * the bytes of each word are reversed on the way out and back, for
+   * buffers kept in the device's big-endian byte order */
+  inline void transfer16(uint16_t *buf, size_t count, bool swap = false) {
+      wordTransfer(buf, count, SPI_16_BIT, swap);
+  }
+  inline void transfer32(uint32_t *buf, size_t count, bool swap = false) {
+      wordTransfer(buf, count, SPI_32_BIT, swap);
+  }
+
+  /* Send 'count' bytes from 'tx' (0xFF when NULL) and receive as many into
+   * 'rx'; with 'rx' NULL the controller runs transmit-only and what comes
+   * back is dropped. 'tx' and 'rx' may be the same buffer. This one starts
+   * a DMA transfer and returns; 'callback' runs from the DMA interrupt once
+   * the last byte is on the wire, and the buffers stay in use until then.
+   * Buffers in DCCM, which DMA cannot reach, and LSBFIRST are done through
+   * the FIFO before returning, still with a callback. Returns false if a
+   * transfer is already running or 'count' is out of range. */
+  bool transfer(const void *tx, void *rx, size_t count, SPICallback callback,
+                void *arg = NULL);
+  /* The same, waiting for completion */
+  void transfer(const void *tx, void *rx, size_t count);
+  inline bool transferBusy(void) { return dmaBusy; }
+
+  /* Run 'transaction', including its beginTransaction()/endTransaction().
+   * Segments between chip select releases and delays are chained into one
+   * DMA run; the CS and delay steps are done from the DMA interrupt before
+   * the next run starts, and 'callback' follows the last one. Where DMA
+   * cannot be used (see above, or with interrupts off) the whole
+   * transaction is done before returning. Returns false if a transfer is
+   * already running or the transaction cannot be started */
+  bool transfer(const SPITransaction &transaction, SPICallback callback,
+                void *arg = NULL);
+  /* The same, waiting for completion */
+  void transfer(const SPITransaction &transaction);
+
   /* After performing a group of transfers and releasing the chip select
    * signal, this function allows others to access the SPI bus */
   inline void endTransaction(void) {
@@ -287,6 +349,40 @@ private:
   bool lsbFirst;
   uint32_t frameSize;
 
+  uint8_t dmaTxInterface;
+  uint8_t dmaRxInterface;
+  bool dmaReady;
+  bool dmaTxOnly;
+  volatile bool dmaBusy;
+  struct soc_dma_channel dmaTxChannel;
+  struct soc_dma_channel dmaRxChannel;
+  struct soc_dma_cfg dmaTxCfg;
+  struct soc_dma_cfg dmaRxCfg;
+  struct soc_dma_xfer_item dmaTxItems[SPI_DMA_ITEMS - 1];
+  struct soc_dma_xfer_item dmaRxItems[SPI_DMA_ITEMS - 1];
+  SPICallback dmaCallback;
+  void *dmaArg;
+  const SPITransaction *txn;
+  uint8_t txnNext;           /* first segment not yet started */
+
+  void fifoTransfer(const uint8_t *tx, uint8_t *rx, size_t count);
+  void wordTransfer(void *buf, size_t count, uint32_t size, bool swap);
+  bool dmaUsable(const SPISegment *seg, uint8_t n);
+  bool dmaAcquire(void);
+  void dmaRelease(void);
+  bool dmaStart(const SPISegment *seg, uint8_t n);
+  void dmaFinish(int status);
+  void txnFifo(const SPITransaction &transaction);
+  void txnEnd(void);
+  static void txnGap(uint8_t csPin, const SPISegment *seg);
+  int txnStep(void);
+  static bool dmaChain(struct soc_dma_cfg *cfg,
+                       struct soc_dma_xfer_item *more,
+                       const SPISegment *seg, uint8_t n, bool tx);
+  static void dmaTxDone(void *arg);
+  static void dmaRxDone(void *arg);
+  static void dmaError(void *arg);
+
   inline void setFrameSize(uint32_t size) {
     if (frameSize != size) {
       /* disable controller */
@@ -313,11 +409,11 @@ private:
 
     void init();
 	void set_dev(int dev);
-	int spidevs[NUM_SPIDEVS][4] =
+	int spidevs[NUM_SPIDEVS][6] =
     {
-        /* base addr.                     Clk. enable value    Clk. disable value    SS GPIO */
-        {(int)SOC_MST_SPI0_REGISTER_BASE, ENABLE_SPI_MASTER_0, DISABLE_SPI_MASTER_0, SPI0_CS},
-        {(int)SOC_MST_SPI1_REGISTER_BASE, ENABLE_SPI_MASTER_1, DISABLE_SPI_MASTER_1, SPI1_CS}
+        /* base addr.                     Clk. enable value    Clk. disable value    SS GPIO  DMA TX / RX handshake */
+        {(int)SOC_MST_SPI0_REGISTER_BASE, ENABLE_SPI_MASTER_0, DISABLE_SPI_MASTER_0, SPI0_CS, SOC_DMA_INTERFACE_SPIM0_TX, SOC_DMA_INTERFACE_SPIM0_RX},
+        {(int)SOC_MST_SPI1_REGISTER_BASE, ENABLE_SPI_MASTER_1, DISABLE_SPI_MASTER_1, SPI1_CS, SOC_DMA_INTERFACE_SPIM1_TX, SOC_DMA_INTERFACE_SPIM1_RX}
     };
 };
 
@@ -33,6 +33,9 @@
 #define     RXFL                  (0x24) /* SoC SPI Receive FIFO Level */
 #define     SR                    (0x28) /* SoC SPI Status Register */
 #define     IMR                   (0x2C) /* SoC SPI Interrupt Mask */
+#define     DMACR                 (0x4C) /* SoC SPI DMA Control */
+#define     DMATDLR               (0x50) /* SoC SPI DMA Transmit Data Level */
+#define     DMARDLR               (0x54) /* SoC SPI DMA Receive Data Level */
 #define     DR                    (0x60) /* SoC SPI Data */
 
 /* SPI specific macros */
@@ -40,6 +43,9 @@
 #define     SPI_ENABLE            (0x1)  /* Enable SoC SPI Device */
 #define     SPI_DISABLE           (0x0)  /* Disable SoC SPI Device */
 #define     SPI_STATUS_BUSY       (0x1)               /* Busy status */
+#define     SPI_STATUS_TFE        (0x4)               /* TX FIFO empty */
+#define     SPI_DMA_RX_ENABLE     (0x1)
+#define     SPI_DMA_TX_ENABLE     (0x2)
 
 #define     SPI_8_BIT             (7)    /*  8-bit frame size */
 #define     SPI_16_BIT            (15)   /* 16-bit frame size */
@@ -48,6 +54,8 @@
 
 #define     SPI_MODE_MASK         (0xC0) /* CPOL=bit 7, CPHA=bit 6 on CTRL0 */
 #define     SPI_MODE_SHIFT        (6)
+#define     SPI_TMOD_MASK         (0x300) /* Transfer mode on CTRL0 */
+#define     SPI_TMOD_TX_ONLY      (0x100)
 #define     SPI_FSIZE_MASK        (0x1F0000) /* Valid frame sizes: 1-32 bits */
 #define     SPI_FSIZE_SHIFT       (16)
 #define     SPI_CLOCK_MASK        (0xFFFE)  /* Clock divider: any even value
@@ -88,4 +96,8 @@ static inline uint32_t arc32_bit_reverse(register uint32_t src,
 #define SPI_REVERSE_24(b) arc32_bit_reverse((b), 24)
 #define SPI_REVERSE_32(b) arc32_bit_reverse((b), 32)
 
+/* Byte order swaps for word frames */
+#define SPI_SWAP_16(w)    ((((w) & 0xFF) << 8) | (((w) >> 8) & 0xFF))
+#define SPI_SWAP_32(w)    __builtin_bswap32(w)
+
 #endif /* _SPI_REGISTERS_H_ */
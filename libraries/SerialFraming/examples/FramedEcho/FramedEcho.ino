@@ -0,0 +1,39 @@
+/*
+  Framed echo
+
+  Receives COBS encoded, CRC-16 checked frames on Serial and sends each
+  good frame straight back, framed the same way. Frames are decoded from
+  serialEvent(), which runs between calls to loop() whenever Serial has
+  data waiting.
+
+  This example code is in the public domain.
+*/
+
+#include <SerialFraming.h>
+
+uint8_t frameBuffer[128];
+FrameDecoder decoder(frameBuffer, sizeof(frameBuffer), FRAME_COBS, FRAME_CHECK_CRC16);
+FrameEncoder encoder(Serial, FRAME_COBS, FRAME_CHECK_CRC16);
+
+void echoFrame(const uint8_t *payload, size_t len, void *ctx)
+{
+  encoder.send(payload, len);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // wait for serial port to connect
+  }
+  decoder.onFrame(echoFrame);
+}
+
+void loop()
+{
+}
+
+void serialEvent()
+{
+  decoder.poll(Serial);
+}
@@ -0,0 +1,364 @@
+/*
+SerialFraming.cpp
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+#include "SerialFraming.h"
+
+#define SLIP_END      0xC0
+#define SLIP_ESC      0xDB
+#define SLIP_ESC_END  0xDC
+#define SLIP_ESC_ESC  0xDD
+
+// Bytes read from the stream per readBytes() call in poll()
+#define FRAME_POLL_CHUNK  32
+
+/******************************************************************************
+* CRC
+******************************************************************************/
+
+// Nibble tables: 96 bytes of flash instead of 1.5K for byte tables, at two
+// lookups per byte
+static const uint16_t crc16_nibble[16] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static const uint32_t crc32_nibble[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+  0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+  0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+// Start with crc = 0xFFFF
+uint16_t crc16_ccitt(uint16_t crc, const uint8_t *data, size_t len)
+{
+  while (len--) {
+    uint8_t b = *data++;
+    crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (b >> 4)];
+    crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (b & 0x0F)];
+  }
+  return crc;
+}
+
+// Start with crc = 0, chain calls by passing the previous result back in
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+  crc = ~crc;
+  while (len--) {
+    crc ^= *data++;
+    crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+    crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+static size_t checkSize(FrameCheck check)
+{
+  switch (check) {
+    case FRAME_CHECK_CRC16: return 2;
+    case FRAME_CHECK_CRC32: return 4;
+    default: return 0;
+  }
+}
+
+static uint32_t checkInit(FrameCheck check)
+{
+  return (check == FRAME_CHECK_CRC16) ? 0xFFFF : 0;
+}
+
+static uint32_t checkUpdate(FrameCheck check, uint32_t crc, const uint8_t *data, size_t len)
+{
+  if (check == FRAME_CHECK_CRC16)
+    return crc16_ccitt((uint16_t)crc, data, len);
+  if (check == FRAME_CHECK_CRC32)
+    return crc32_update(crc, data, len);
+  return 0;
+}
+
+/******************************************************************************
+* Decoder
+******************************************************************************/
+
+FrameDecoder::FrameDecoder(uint8_t *buf, size_t size, FrameCodec codec, FrameCheck check)
+  : _buf(buf), _size(size), _codec(codec), _check(check), _cb(NULL), _ctx(NULL),
+    _frames(0), _checkErrors(0), _framingErrors(0), _overruns(0)
+{
+  reset();
+}
+
+void FrameDecoder::reset(void)
+{
+  _len = 0;
+  _left = 0;
+  _code = 0;
+  _escaped = false;
+  _discard = false;
+}
+
+bool FrameDecoder::endFrame(void)
+{
+  size_t len = _len;
+  size_t trailer = checkSize(_check);
+  bool bad = _discard;
+
+  // An unfinished COBS block means bytes went missing
+  if (_codec == FRAME_COBS && _left != 0 && !bad) {
+    _framingErrors++;
+    bad = true;
+  }
+  reset();
+
+  // Back to back delimiters are idle fill, not frames
+  if (bad || len == 0)
+    return false;
+
+  if (len < trailer) {
+    _checkErrors++;
+    return false;
+  }
+  len -= trailer;
+  if (trailer) {
+    uint32_t crc = checkUpdate(_check, checkInit(_check), _buf, len);
+    uint32_t sent = 0;
+    for (size_t i = 0; i < trailer; i++)
+      sent |= (uint32_t)_buf[len + i] << (8 * i);
+    if (crc != sent) {
+      _checkErrors++;
+      return false;
+    }
+  }
+
+  _frames++;
+  if (_cb)
+    _cb(_buf, len, _ctx);
+  return true;
+}
+
+size_t FrameDecoder::feed(const uint8_t *data, size_t len)
+{
+  size_t done = 0;
+  const uint8_t *end = data + len;
+
+  if (_codec == FRAME_COBS) {
+    while (data < end) {
+      uint8_t b = *data++;
+      if (b == 0) {
+        done += endFrame();
+        continue;
+      }
+      if (_discard)
+        continue;
+      if (_left == 0) {
+        // Code byte; every block but a full one implies a zero, emitted
+        // only once another block follows so the last one never adds it
+        if (_code != 0 && _code != 0xFF) {
+          if (_len == _size) {
+            _overruns++;
+            _discard = true;
+            continue;
+          }
+          _buf[_len++] = 0;
+        }
+        _code = b;
+        _left = b - 1;
+        continue;
+      }
+      // Copy the run of data bytes in the current block in one go
+      size_t run = _left;
+      if (run > (size_t)(end - data) + 1)
+        run = (size_t)(end - data) + 1;
+      const uint8_t *src = data - 1;
+      size_t i;
+      for (i = 0; i < run && src[i] != 0; i++)
+        ;
+      if (_len + i > _size) {
+        _overruns++;
+        _discard = true;
+        data = src + i;
+        continue;
+      }
+      memcpy(_buf + _len, src, i);
+      _len += i;
+      _left -= i;
+      data = src + i;
+    }
+    return done;
+  }
+
+  while (data < end) {
+    uint8_t b = *data++;
+    if (b == SLIP_END) {
+      done += endFrame();
+      continue;
+    }
+    if (_discard)
+      continue;
+    if (_escaped) {
+      _escaped = false;
+      if (b == SLIP_ESC_END)
+        b = SLIP_END;
+      else if (b == SLIP_ESC_ESC)
+        b = SLIP_ESC;
+      else {
+        _framingErrors++;
+        _discard = true;
+        continue;
+      }
+    } else if (b == SLIP_ESC) {
+      _escaped = true;
+      continue;
+    }
+    if (_len == _size) {
+      _overruns++;
+      _discard = true;
+      continue;
+    }
+    _buf[_len++] = b;
+  }
+  return done;
+}
+
+size_t FrameDecoder::poll(Stream &in)
+{
+  uint8_t chunk[FRAME_POLL_CHUNK];
+  size_t done = 0;
+  int n;
+
+  // Only ask for what is already buffered, so readBytes() never waits
+  while ((n = in.available()) > 0) {
+    if (n > FRAME_POLL_CHUNK)
+      n = FRAME_POLL_CHUNK;
+    n = in.readBytes((char*)chunk, n);
+    if (n <= 0)
+      break;
+    done += feed(chunk, n);
+  }
+  return done;
+}
+
+/******************************************************************************
+* Encoder
+******************************************************************************/
+
+FrameEncoder::FrameEncoder(Print &out, FrameCodec codec, FrameCheck check)
+  : _out(out), _codec(codec), _check(check)
+{
+  begin();
+}
+
+void FrameEncoder::flushBlock(size_t n)
+{
+  if (_out.write(_blk, n) != n)
+    _error = true;
+}
+
+// Send the finished COBS blocks and keep the open one, whose code byte is
+// not known yet; it is under 255 bytes so this always makes room
+void FrameEncoder::spill(void)
+{
+  flushBlock(_code);
+  _n -= _code;
+  memmove(_blk, _blk + _code, _n);
+  _code = 0;
+}
+
+void FrameEncoder::begin(void)
+{
+  _crc = checkInit(_check);
+  _error = false;
+  _code = 0;
+  if (_codec == FRAME_COBS) {
+    _n = 1;
+  } else {
+    // A leading END flushes any line noise the receiver has collected
+    _blk[0] = SLIP_END;
+    _n = 1;
+  }
+}
+
+void FrameEncoder::put(uint8_t b)
+{
+  if (_codec == FRAME_COBS) {
+    // A byte can also close the block and open the next code slot
+    if (_n + 1 >= sizeof(_blk))
+      spill();
+    if (b == 0) {
+      _blk[_code] = _n - _code;
+      _code = _n++;
+      return;
+    }
+    _blk[_n++] = b;
+    if (_n - _code == 0xFF) {
+      _blk[_code] = 0xFF;
+      _code = _n++;
+    }
+    return;
+  }
+
+  // Leave room for an escape pair plus the closing END
+  if (_n > sizeof(_blk) - 3) {
+    flushBlock(_n);
+    _n = 0;
+  }
+  if (b == SLIP_END) {
+    _blk[_n++] = SLIP_ESC;
+    _blk[_n++] = SLIP_ESC_END;
+  } else if (b == SLIP_ESC) {
+    _blk[_n++] = SLIP_ESC;
+    _blk[_n++] = SLIP_ESC_ESC;
+  } else {
+    _blk[_n++] = b;
+  }
+}
+
+void FrameEncoder::write(const uint8_t *data, size_t len)
+{
+  _crc = checkUpdate(_check, _crc, data, len);
+  while (len--)
+    put(*data++);
+}
+
+bool FrameEncoder::end(void)
+{
+  size_t trailer = checkSize(_check);
+  for (size_t i = 0; i < trailer; i++)
+    put((uint8_t)(_crc >> (8 * i)));
+
+  // The delimiter goes out with the last block
+  if (_codec == FRAME_COBS) {
+    if (_n >= sizeof(_blk))
+      spill();
+    _blk[_code] = _n - _code;
+    _blk[_n++] = 0;
+  } else {
+    _blk[_n++] = SLIP_END;
+  }
+  flushBlock(_n);
+
+  bool ok = !_error;
+  begin();
+  return ok;
+}
+
+bool FrameEncoder::send(const uint8_t *payload, size_t len)
+{
+  begin();
+  write(payload, len);
+  return end();
+}
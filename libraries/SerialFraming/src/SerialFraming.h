@@ -0,0 +1,128 @@
+/*
+SerialFraming.h
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+Packet framing over any Stream/Print: COBS or SLIP byte stuffing with an
+optional CRC-16/CCITT or CRC-32 trailer.  Neither side allocates; the
+decoder assembles frames into a caller-supplied buffer and hands each
+complete, checked frame to a callback.  Both sides move data in blocks,
+so a frame costs a handful of virtual calls rather than one per byte.
+*/
+
+#ifndef SerialFraming_h
+#define SerialFraming_h
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <Stream.h>
+
+enum FrameCodec {
+  FRAME_COBS = 0,       // 0x00 delimited, at most one byte overhead per 254
+  FRAME_SLIP            // RFC 1055, 0xC0 delimited
+};
+
+enum FrameCheck {
+  FRAME_CHECK_NONE = 0,
+  FRAME_CHECK_CRC16,    // CRC-16/CCITT-FALSE, sent little-endian
+  FRAME_CHECK_CRC32     // CRC-32 (IEEE 802.3), sent little-endian
+};
+
+uint16_t crc16_ccitt(uint16_t crc, const uint8_t *data, size_t len);
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len);
+
+// Called with the payload of each good frame, check bytes stripped.  The
+// data is only valid for the duration of the call.  Without a check, empty
+// frames cannot be told apart from idle delimiters and are not reported.
+typedef void (*FrameCallback)(const uint8_t *payload, size_t len, void *ctx);
+
+class FrameDecoder
+{
+public:
+  // 'buf' must hold the largest expected payload plus its check bytes
+  FrameDecoder(uint8_t *buf, size_t size, FrameCodec codec = FRAME_COBS,
+               FrameCheck check = FRAME_CHECK_CRC16);
+
+  void onFrame(FrameCallback cb, void *ctx = NULL) { _cb = cb; _ctx = ctx; }
+
+  // Decode raw bytes; returns the number of good frames completed
+  size_t feed(const uint8_t *data, size_t len);
+  // Drain whatever 'in' has buffered without waiting, suitable for calling
+  // from serialEvent(); returns the number of good frames completed
+  size_t poll(Stream &in);
+  // Drop any partially received frame
+  void reset(void);
+
+  uint32_t frames(void) const { return _frames; }
+  uint32_t checkErrors(void) const { return _checkErrors; }
+  uint32_t framingErrors(void) const { return _framingErrors; }
+  uint32_t overruns(void) const { return _overruns; }
+
+private:
+  bool endFrame(void);
+
+  uint8_t *_buf;
+  size_t _size;
+  size_t _len;
+  FrameCodec _codec;
+  FrameCheck _check;
+  FrameCallback _cb;
+  void *_ctx;
+
+  uint8_t _left;        // COBS: data bytes left in the current block
+  uint8_t _code;        // COBS: code byte of the current block, 0 at frame start
+  bool _escaped;        // SLIP: previous byte was ESC
+  bool _discard;        // frame overran or was malformed, skip to delimiter
+
+  uint32_t _frames;
+  uint32_t _checkErrors;
+  uint32_t _framingErrors;
+  uint32_t _overruns;
+};
+
+class FrameEncoder
+{
+public:
+  FrameEncoder(Print &out, FrameCodec codec = FRAME_COBS,
+               FrameCheck check = FRAME_CHECK_CRC16);
+
+  // Encode and send a whole frame; returns false if the sink took less
+  // than everything
+  bool send(const uint8_t *payload, size_t len);
+
+  // Or build a frame piecewise: begin(), any number of write(), end()
+  void begin(void);
+  void write(const uint8_t *data, size_t len);
+  void write(uint8_t b) { write(&b, 1); }
+  bool end(void);
+
+private:
+  void put(uint8_t b);
+  void flushBlock(size_t n);
+  void spill(void);
+
+  Print &_out;
+  FrameCodec _codec;
+  FrameCheck _check;
+  uint32_t _crc;
+  bool _error;
+  // Output staging. For COBS it holds whole blocks plus the open one,
+  // whose code byte at _code is filled in once the block closes.
+  uint8_t _blk[320];
+  size_t _n;
+  size_t _code;
+};
+
+#endif
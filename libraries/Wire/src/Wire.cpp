@@ -23,6 +23,7 @@
 
 extern "C" {
 #include <i2c.h>
+#include <stdlib.h>
 #include <string.h>
 }
 
@@ -30,40 +31,93 @@ extern "C" {
 #include "variant.h"
 
 TwoWire::TwoWire(I2C_CONTROLLER _controller_id)
-    : rxBufferIndex(0), rxBufferLength(0), init_status(-1),
-      controller_id(_controller_id)
+    : rxBuffer(NULL), rxBufferIndex(0), rxBufferLength(0), txBuffer(NULL),
+      txBufferLength(0), init_status(-1), controller_id(_controller_id)
 {
-    rxBuffer = (uint8_t*)dccm_malloc(BUFFER_LENGTH);
-    txBuffer = (uint8_t*)dccm_malloc(BUFFER_LENGTH);
+}
+
+// Buffers live in DCCM while the bus is open and are handed back on end()
+bool TwoWire::allocBuffers(void)
+{
+    if (rxBuffer == NULL)
+        rxBuffer = (uint8_t*)dccm_malloc(BUFFER_LENGTH);
+    if (rxBuffer == NULL)
+        rxBuffer = (uint8_t*)malloc(BUFFER_LENGTH);
+    if (txBuffer == NULL)
+        txBuffer = (uint8_t*)dccm_malloc(BUFFER_LENGTH);
+    if (txBuffer == NULL)
+        txBuffer = (uint8_t*)malloc(BUFFER_LENGTH);
+    return rxBuffer != NULL && txBuffer != NULL;
 }
 
 void TwoWire::begin(void)
 {
+    if (!allocBuffers()) {
+        init_status = I2C_ERROR;
+        return;
+    }
     init_status = i2c_openadapter(controller_id);
 }
 
 void TwoWire::begin(int i2c_speed)
 {
+    if (!allocBuffers()) {
+        init_status = I2C_ERROR;
+        return;
+    }
     init_status = i2c_openadapter_speed(controller_id, i2c_speed);
 }
 
+static void releaseBuffer(uint8_t *buf)
+{
+    if (dccm_owns(buf))
+        dccm_free(buf);
+    else
+        free(buf);
+}
+
+void TwoWire::end(void)
+{
+    if (init_status >= 0)
+        i2c_closeadapter(controller_id);
+    init_status = -1;
+
+    releaseBuffer(rxBuffer);
+    releaseBuffer(txBuffer);
+    rxBuffer = NULL;
+    txBuffer = NULL;
+    rxBufferIndex = 0;
+    rxBufferLength = 0;
+    txBufferLength = 0;
+}
+
 void TwoWire::setClock(long speed)
 {
-    if (speed == 400000L) {
-        init_status = i2c_openadapter_speed(controller_id, I2C_SPEED_FAST);
-    } else if (speed == 100000L) {
-        init_status = i2c_openadapter_speed(controller_id, I2C_SPEED_SLOW);
-    } else if (speed == I2C_SPEED_FAST) {
-        init_status = i2c_openadapter_speed(controller_id, I2C_SPEED_FAST);
-    } else {
-        init_status = i2c_openadapter(controller_id);
-    }
+    if (speed == I2C_SPEED_SLOW)
+        speed = 100000L;
+    else if (speed == I2C_SPEED_FAST)
+        speed = 400000L;
+    if (init_status < 0)
+        begin();
+    // Takes effect with the next transaction, nothing is reopened
+    i2c_set_clock(controller_id, speed);
+}
+
+void TwoWire::setClock(uint8_t address, long speed)
+{
+    if (speed == I2C_SPEED_SLOW)
+        speed = 100000L;
+    else if (speed == I2C_SPEED_FAST)
+        speed = 400000L;
+    i2c_set_device_clock(controller_id, address, speed);
 }
 
 uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity,
                              uint8_t sendStop)
 {
     int ret;
+    if (rxBuffer == NULL)
+        return 0;
     if (quantity > BUFFER_LENGTH)
         quantity = BUFFER_LENGTH;
 
@@ -95,6 +149,66 @@ uint8_t TwoWire::requestFrom(int address, int quantity, int sendStop)
     return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)sendStop);
 }
 
+uint8_t TwoWire::readRegisters(uint8_t address, uint8_t reg, uint8_t *buf,
+                               size_t len)
+{
+    if (init_status < 0)
+        return -I2C_ERROR;
+    i2c_setslave(controller_id, address);
+    // Register write, repeated start and read all go out as one transfer
+    int err = i2c_transfer(controller_id, &reg, 1, buf, len, false);
+    if (err < 0)
+        return -err;
+    return 0;
+}
+
+uint8_t TwoWire::writeRegisters(uint8_t address, uint8_t reg,
+                                const uint8_t *buf, size_t len)
+{
+    uint8_t stack[BUFFER_LENGTH + 1];
+    uint8_t *frame = stack;
+    int err;
+
+    if (init_status < 0)
+        return -I2C_ERROR;
+    // The register byte and the payload have to go out as one message, a
+    // second transfer would start over with a new START and address
+    if (len > BUFFER_LENGTH) {
+        frame = (uint8_t *)malloc(len + 1);
+        if (frame == NULL)
+            return 1;
+    }
+    frame[0] = reg;
+    memcpy(frame + 1, buf, len);
+    i2c_setslave(controller_id, address);
+    err = i2c_transfer(controller_id, frame, len + 1, NULL, 0, false);
+    if (frame != stack)
+        free(frame);
+    if (err < 0)
+        return -err;
+    return 0;
+}
+
+uint8_t TwoWire::recoverBus(void)
+{
+    if (init_status < 0)
+        return -I2C_ERROR;
+    int err = i2c_recover(controller_id);
+    if (err < 0)
+        return -err;
+    return 0;
+}
+
+void TwoWire::setRetries(uint8_t retries, uint32_t backoffUs)
+{
+    i2c_set_retry(controller_id, retries, backoffUs);
+}
+
+bool TwoWire::getStats(uint8_t address, struct i2c_stats *stats)
+{
+    return i2c_get_stats(controller_id, address, stats) == I2C_OK;
+}
+
 void TwoWire::beginTransmission(uint8_t address)
 {
     if (init_status < 0)
@@ -154,7 +268,7 @@ uint8_t TwoWire::endTransmission(void)
 
 size_t TwoWire::write(uint8_t data)
 {
-    if (txBufferLength >= BUFFER_LENGTH)
+    if (txBuffer == NULL || txBufferLength >= BUFFER_LENGTH)
         return 0;
     txBuffer[txBufferLength++] = data;
     return 1;
@@ -162,6 +276,8 @@ size_t TwoWire::write(uint8_t data)
 
 size_t TwoWire::write(const uint8_t *data, size_t quantity)
 {
+    if (txBuffer == NULL)
+        return 0;
     for (size_t i = 0; i < quantity; ++i) {
         if (txBufferLength >= BUFFER_LENGTH)
             return i;
@@ -24,6 +24,7 @@
 #include "Stream.h"
 #include "variant.h"
 #include "ss_i2c_iface.h"
+#include "i2c.h"
 
 #define BUFFER_LENGTH   32
 #define I2C_SPEED_SLOW  1
@@ -34,7 +35,12 @@ public:
 	TwoWire(I2C_CONTROLLER _controller_id);
 	void begin(void);
     void begin(int speed);
+	void end(void);
     void setClock(long speed);
+	// Clock for one device, switched to whenever it is addressed so fast
+	// devices are not held back by slow ones; 0 goes back to the bus clock.
+	// Up to 1MHz (Fast-mode Plus).
+	void setClock(uint8_t address, long speed);
 	void beginTransmission(uint8_t);
 	void beginTransmission(int);
 	uint8_t endTransmission(void);
@@ -43,6 +49,18 @@ public:
 	uint8_t requestFrom(uint8_t, uint8_t, uint8_t);
 	uint8_t requestFrom(int, int);
 	uint8_t requestFrom(int, int, int);
+	// Register access in a single bus transaction, no BUFFER_LENGTH limit.
+	// Reads go straight to the caller's buffer; writes are staged behind
+	// the register byte, on the heap past BUFFER_LENGTH. Return 0 on
+	// success or an endTransmission() style error code, 1 if staging fails.
+	uint8_t readRegisters(uint8_t address, uint8_t reg, uint8_t *buf, size_t len);
+	uint8_t writeRegisters(uint8_t address, uint8_t reg, const uint8_t *buf, size_t len);
+	// Timed out transfers free the bus and are retried, see i2c.h.
+	// recoverBus() returns 0 or an endTransmission() style error code;
+	// getStats() takes I2C_STATS_BUS for the totals.
+	uint8_t recoverBus(void);
+	void setRetries(uint8_t retries, uint32_t backoffUs);
+	bool getStats(uint8_t address, struct i2c_stats *stats);
 	virtual size_t write(uint8_t);
 	virtual size_t write(const uint8_t *, size_t);
 	virtual int available(void);
@@ -69,6 +87,8 @@ private:
 
 	int init_status;
 
+	bool allocBuffers(void);
+
     I2C_CONTROLLER controller_id;
 };
 
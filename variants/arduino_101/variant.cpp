@@ -127,8 +127,15 @@ void serialEvent() { }
 
 // Serial1 - Arduino Header Pins 0 and 1
 
-RingBuffer rx_buffer_uart;
-RingBuffer tx_buffer_uart;
+#ifndef SERIAL1_RX_BUFFER_SIZE
+#define SERIAL1_RX_BUFFER_SIZE UART_BUFFER_SIZE
+#endif
+#ifndef SERIAL1_TX_BUFFER_SIZE
+#define SERIAL1_TX_BUFFER_SIZE UART_BUFFER_SIZE
+#endif
+
+RingBufferN<SERIAL1_RX_BUFFER_SIZE> rx_buffer_uart;
+RingBufferN<SERIAL1_TX_BUFFER_SIZE> tx_buffer_uart;
 uart_init_info info_uart;
 
 UARTClass Serial1(&info_uart, &rx_buffer_uart, &tx_buffer_uart);
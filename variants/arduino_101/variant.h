@@ -72,6 +72,9 @@ extern "C"{
  */
 #define WIRE_INTERFACES_COUNT 1
 #define I2C_MUX_MODE       QRK_PMUX_SEL_MODEA
+/* GPIO header pins on the same lines as I2C_SENSING_0 */
+#define PIN_WIRE_SDA       (18u)
+#define PIN_WIRE_SCL       (19u)
 
 /*
  * SPI